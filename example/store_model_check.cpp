@@ -0,0 +1,160 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Randomized check of ImTerm::message_store against a reference model (a deque of the stored messages): pushes, bulk pushes,
+// clears, and resizes (set_max_size) of a ring buffer that has usually wrapped around.
+// Returns EXIT_FAILURE and describes the first mismatch, if any.
+//
+// usage: ImTerm-StoreModelCheck [seed] [operations]
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "imterm/message_store.hpp"
+
+namespace {
+	struct model_message {
+		ImTerm::message_store::seq_type seq;
+		ImTerm::message::severity::severity_t severity;
+		bool is_term_message;
+		std::string value;
+	};
+
+	// what message_store should hold
+	struct model {
+		std::deque<model_message> messages{};
+		ImTerm::message_store::size_type max_size;
+		ImTerm::message_store::seq_type end_seq{0u};
+
+		void push(const ImTerm::message& msg) {
+			if (max_size != 0u) {
+				messages.push_back({end_seq, msg.severity, msg.is_term_message, msg.value});
+			}
+			++end_seq;
+			shrink();
+		}
+
+		void shrink() {
+			while (messages.size() > max_size) {
+				messages.pop_front();
+			}
+		}
+
+		ImTerm::message_store::seq_type first_seq() const {
+			return messages.empty() ? end_seq : messages.front().seq;
+		}
+	};
+
+	// returns a description of the first difference between the store and the model, an empty string if there is none
+	std::string compare(ImTerm::message_store& store, const model& expected) {
+		std::string error;
+		store.lock();
+		if (store.size() != expected.messages.size()) {
+			error = "size " + std::to_string(store.size()) + ", expected " + std::to_string(expected.messages.size());
+		} else if (store.first_seq() != expected.first_seq() || store.end_seq() != expected.end_seq) {
+			error = "sequence numbers [" + std::to_string(store.first_seq()) + ", " + std::to_string(store.end_seq()) + "), expected ["
+			        + std::to_string(expected.first_seq()) + ", " + std::to_string(expected.end_seq) + ")";
+		}
+
+		for (auto it = expected.messages.begin() ; error.empty() && it != expected.messages.end() ; ++it) {
+			const ImTerm::message& msg = store.at(it->seq);
+			if (msg.value != it->value || msg.severity != it->severity || msg.is_term_message != it->is_term_message) {
+				error = "message " + std::to_string(it->seq) + " is '" + msg.value + "', expected '" + it->value + "'";
+			}
+		}
+
+		// indexes: sequence numbers of each severity, and of terminal messages
+		for (int severity = ImTerm::message::severity::trace ; error.empty() && severity <= ImTerm::message::severity::critical + 1 ; ++severity) {
+			const bool term = severity > ImTerm::message::severity::critical;
+			const ImTerm::message_store::seq_list& index = term ? store.term_messages()
+			                                                    : store.messages_of(static_cast<ImTerm::message::severity::severity_t>(severity));
+			ImTerm::message_store::seq_list expected_index;
+			for (const model_message& msg : expected.messages) {
+				if (msg.is_term_message == term && (term || msg.severity == severity)) {
+					expected_index.push_back(msg.seq);
+				}
+			}
+			if (index != expected_index) {
+				error = std::string{"index of "} + (term ? "terminal messages" : "severity " + std::to_string(severity)) + " differs";
+			}
+		}
+		store.unlock();
+		return error;
+	}
+}
+
+int main(int argc, char** argv) {
+	const unsigned long seed = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 42ul;
+	const long operations = argc > 2 ? std::strtol(argv[2], nullptr, 10) : 200'000l;
+
+	std::mt19937_64 random{seed};
+	auto between = [&random](auto min, auto max) {
+		return std::uniform_int_distribution<decltype(max)>{min, max}(random);
+	};
+	auto make_message = [&](ImTerm::message_store::seq_type n) {
+		ImTerm::message msg{static_cast<ImTerm::message::severity::severity_t>(between(0, 5)), "message " + std::to_string(n), 0u, 0u,
+		                    between(0, 9) == 0};
+		if (between(0, 3) == 0) {
+			msg.value.append(between(20u, 200u), 'x'); // not stored inline
+		}
+		return msg;
+	};
+
+	ImTerm::message_store store{64u};
+	model expected{{}, 64u};
+	for (long op = 0 ; op < operations ; ++op) {
+		const int kind = between(0, 99);
+		std::string what;
+		if (kind < 70) {
+			ImTerm::message msg = make_message(expected.end_seq);
+			expected.push(msg);
+			store.push(std::move(msg));
+			what = "push";
+		} else if (kind < 85) {
+			std::vector<ImTerm::message> msgs;
+			for (int i = between(0, 40) ; i > 0 ; --i) {
+				msgs.push_back(make_message(expected.end_seq));
+				expected.push(msgs.back());
+			}
+			what = "push_bulk of " + std::to_string(msgs.size());
+			store.push_bulk(msgs);
+		} else if (kind < 99) {
+			// mostly around the current size, so that the ring buffer is both grown and shrunk while wrapped
+			const auto max_size = between(0, 9) == 0 ? between(std::size_t{0u}, std::size_t{4u}) : between(std::size_t{1u}, std::size_t{128u});
+			expected.max_size = max_size;
+			expected.shrink();
+			store.set_max_size(max_size);
+			what = "set_max_size(" + std::to_string(max_size) + ")";
+		} else {
+			expected.messages.clear();
+			store.clear();
+			what = "clear";
+		}
+
+		const std::string error = compare(store, expected);
+		if (!error.empty()) {
+			std::fprintf(stderr, "seed %lu, operation %ld (%s): %s\n", seed, op, what.c_str(), error.c_str());
+			return EXIT_FAILURE;
+		}
+	}
+	std::printf("seed %lu: %ld operations, no mismatch\n", seed, operations);
+	return EXIT_SUCCESS;
+}
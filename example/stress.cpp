@@ -0,0 +1,130 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Stress test: producer threads log through spdlog to a terminal drawn at 60 Hz by the main thread, without a window.
+// Reports the ingestion throughput, the latency percentiles of the logging calls, the contention on the message store's lock,
+// and the delay before messages are drawn (see terminal::set_latency_tracing).
+// Built with -DIMTERM_STRESS_TSAN=ON, ThreadSanitizer makes it fail on data races.
+//
+// usage: ImTerm-Stress [producers] [messages per producer]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <imgui.h>
+#include <spdlog/spdlog.h>
+
+#include "imterm/terminal.hpp"
+#include "imterm/terminal_helpers.hpp"
+
+namespace {
+	class stress_helper : public ImTerm::basic_spdlog_terminal_helper<stress_helper, void, std::mutex> {};
+
+	long long to_us(std::chrono::nanoseconds duration) {
+		return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+	}
+}
+
+int main(int argc, char** argv) {
+	const int producers = argc > 1 ? std::atoi(argv[1]) : 4;
+	const int messages = argc > 2 ? std::atoi(argv[2]) : 50'000;
+	if (producers <= 0 || messages <= 0) {
+		std::fprintf(stderr, "usage: %s [producers] [messages per producer]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// no window: frames are built, but not rendered
+	ImGui::CreateContext();
+	ImGuiIO& io = ImGui::GetIO();
+	io.IniFilename = nullptr;
+	io.DisplaySize = ImVec2(1280.f, 720.f);
+	unsigned char* pixels;
+	int width;
+	int height;
+	io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+	{
+		ImTerm::terminal<stress_helper> term;
+		term.set_max_log_len(100'000);
+		term.set_latency_tracing(true);
+
+		auto logger = std::make_shared<spdlog::logger>("stress", term.get_terminal_helper());
+		logger->set_level(spdlog::level::trace);
+
+		std::vector<std::vector<std::chrono::nanoseconds>> latencies(static_cast<std::size_t>(producers));
+		std::atomic<int> running{producers};
+		std::vector<std::thread> threads;
+		const auto beg = std::chrono::steady_clock::now();
+		for (int p = 0 ; p < producers ; ++p) {
+			threads.emplace_back([&, p]() {
+				std::vector<std::chrono::nanoseconds>& latency = latencies[static_cast<std::size_t>(p)];
+				latency.reserve(static_cast<std::size_t>(messages));
+				for (int i = 0 ; i < messages ; ++i) {
+					const auto call_beg = std::chrono::steady_clock::now();
+					logger->info("producer {} message {}", p, i);
+					latency.push_back(std::chrono::steady_clock::now() - call_beg);
+				}
+				--running;
+			});
+		}
+
+		unsigned long frames = 0ul;
+		auto next_frame = std::chrono::steady_clock::now();
+		do {
+			io.DeltaTime = 1.f / 60.f;
+			ImGui::NewFrame();
+			term.show();
+			ImGui::Render();
+			++frames;
+
+			next_frame += std::chrono::microseconds(16'667);
+			std::this_thread::sleep_until(next_frame);
+		} while (running != 0);
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - beg;
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+
+		std::vector<std::chrono::nanoseconds> all;
+		all.reserve(static_cast<std::size_t>(producers) * static_cast<std::size_t>(messages));
+		for (const std::vector<std::chrono::nanoseconds>& latency : latencies) {
+			all.insert(all.end(), latency.begin(), latency.end());
+		}
+		std::sort(all.begin(), all.end());
+		auto percentile = [&all](double q) {
+			return all[std::min(all.size() - 1, static_cast<std::size_t>(q * static_cast<double>(all.size())))];
+		};
+
+		const ImTerm::message_store::lock_statistics lock_stats = term.get_message_store()->lock_stats();
+		const ImTerm::latency_histogram& display = term.display_latency();
+		std::printf("%d producers, %zu messages in %.3f s over %lu frames: %.0f msg/s\n", producers, all.size(), elapsed.count(), frames,
+		            static_cast<double>(all.size()) / elapsed.count());
+		std::printf("logging call: p50 %lld ns, p99 %lld ns, p999 %lld ns, max %lld us\n", static_cast<long long>(percentile(0.5).count()),
+		            static_cast<long long>(percentile(0.99).count()), static_cast<long long>(percentile(0.999).count()), to_us(all.back()));
+		std::printf("store lock: contended %llu times, %lld us spent waiting\n", lock_stats.contended, to_us(lock_stats.spin_time));
+		std::printf("display: %llu messages drawn, p50 %lld us, p99 %lld us, max %lld us after being logged\n", display.count(),
+		            to_us(display.percentile(0.5)), to_us(display.percentile(0.99)), to_us(display.max()));
+	}
+
+	ImGui::DestroyContext();
+	return EXIT_SUCCESS;
+}
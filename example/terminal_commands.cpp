@@ -21,19 +21,90 @@
 #include <array>
 #include <optional>
 #include <charconv>
+#include <chrono>
+#include <ctime>
 
 namespace {
 
+	enum class limit_kind {
+		bytes,
+		history,
+		messages,
+	};
+
+	constexpr ImTerm::args::schema limit_args{
+			ImTerm::args::choice<limit_kind, 3>{"limit", {{{"bytes", limit_kind::bytes}, {"history", limit_kind::history}, {"messages", limit_kind::messages}}}},
+			ImTerm::args::value<std::size_t>{"count"},
+	};
+
+	enum class buffer_action {
+		erase,
+		list,
+		show,
+	};
+
+	constexpr ImTerm::args::schema buffer_args{
+			ImTerm::args::choice<buffer_action, 3>{"action", {{{"erase", buffer_action::erase}, {"list", buffer_action::list}, {"show", buffer_action::show}}}},
+			ImTerm::args::defaulted<std::string_view>{"@name", {}},
+	};
+
+	enum class latency_action {
+		off,
+		on,
+		reset,
+		show,
+	};
+
+	constexpr ImTerm::args::schema latency_args{
+			ImTerm::args::choice<latency_action, 4>{"action", {{{"off", latency_action::off}, {"on", latency_action::on}, {"reset", latency_action::reset}, {"show", latency_action::show}}}},
+	};
+
+	enum class export_scope {
+		all,
+		filtered,
+	};
+
+	constexpr ImTerm::args::schema export_args{
+			ImTerm::args::choice<export_scope, 2>{"messages", {{{"all", export_scope::all}, {"filtered", export_scope::filtered}}}},
+			ImTerm::args::value<std::string_view>{"file"},
+			ImTerm::args::defaulted<bool>{"tagged", false},
+	};
+
+	enum class time_action {
+		jump,
+		last,
+		reset,
+	};
+
+	constexpr ImTerm::args::schema time_args{
+			ImTerm::args::choice<time_action, 3>{"action", {{{"jump", time_action::jump}, {"last", time_action::last}, {"reset", time_action::reset}}}},
+			ImTerm::args::defaulted<std::string_view>{"value", {}},
+	};
+
+	constexpr ImTerm::args::schema grep_args{
+			ImTerm::args::value<std::string_view>{"text"},
+	};
+
 	constexpr std::array local_command_list {
+			terminal_commands::command_type{"buffer", "shows the output of commands redirected to @name (cmd > @name)", terminal_commands::buffer, ImTerm::args::complete<buffer_args>},
 			terminal_commands::command_type{"clear", "clears the terminal screen", terminal_commands::clear, terminal_commands::no_completion},
 			terminal_commands::command_type{"configure_terminal", "configures terminal behaviour and appearance", terminal_commands::configure_term, terminal_commands::configure_term_autocomplete},
+			terminal_commands::command_type{"count", "counts the lines written by the previous command (cmd | count)", terminal_commands::count, terminal_commands::no_completion},
 			terminal_commands::command_type{"echo", "prints text", terminal_commands::echo, terminal_commands::no_completion},
 			terminal_commands::command_type{"exit", "closes this terminal", terminal_commands::exit, terminal_commands::no_completion},
+			terminal_commands::command_type{"export", "writes logs to a file", terminal_commands::export_logs, ImTerm::args::complete<export_args>},
+			terminal_commands::command_type{"grep", "prints the lines of the previous command containing a text (cmd | grep text)", terminal_commands::grep, terminal_commands::no_completion},
 			terminal_commands::command_type{"help", "show this help", terminal_commands::help, terminal_commands::no_completion},
+			terminal_commands::command_type{"latency", "measures the delay between logging and display", terminal_commands::latency, ImTerm::args::complete<latency_args>},
+			terminal_commands::command_type{"limit", "limits the memory used by logs", terminal_commands::limit, ImTerm::args::complete<limit_args>},
 			terminal_commands::command_type{"print", "prints text", terminal_commands::echo, terminal_commands::no_completion},
 			terminal_commands::command_type{"quit", "closes this application", terminal_commands::quit, terminal_commands::no_completion},
+			terminal_commands::command_type{"time", "filters logs by time", terminal_commands::time, ImTerm::args::complete<time_args>},
 	};
 
+	// sorted, and checked for duplicates, at compile time
+	using local_commands = ImTerm::static_command_table<local_command_list>;
+
 	namespace cfg_term {
 		namespace cmds {
 			enum cmds {
@@ -162,7 +233,7 @@ namespace {
 }
 
 terminal_commands::terminal_commands() {
-	for (const command_type& cmd : local_command_list) {
+	for (const command_type& cmd : local_commands::sorted) {
 		add_command_(cmd);
 	}
 }
@@ -408,6 +479,55 @@ std::vector<std::string> terminal_commands::configure_term_autocomplete(argument
 	return ans;
 }
 
+void terminal_commands::buffer(argument_type& arg) {
+	std::string error;
+	auto parsed = buffer_args.parse(arg.command_line, error);
+	if (!parsed) {
+		arg.term.add_text_err(error);
+		arg.term.add_text_err(buffer_args.usage(arg.command_line[0]));
+		return;
+	}
+
+	auto [action, name] = *parsed;
+	if (!name.empty() && name.front() == '@') {
+		name.remove_prefix(1);
+	}
+	if (action == buffer_action::list) {
+		for (std::string_view buffer_name : arg.term.list_output_buffers()) {
+			arg.term.add_formatted("@{} ({} lines)", buffer_name, arg.term.get_output_buffer(buffer_name)->size());
+		}
+		return;
+	}
+
+	if (name.empty()) {
+		arg.term.add_text_err(buffer_args.usage(arg.command_line[0]));
+		return;
+	}
+	if (action == buffer_action::erase) {
+		if (!arg.term.erase_output_buffer(name)) {
+			arg.term.add_formatted_err("No such buffer: @{}", name);
+		}
+		return;
+	}
+
+	const std::vector<std::string>* lines = arg.term.get_output_buffer(name);
+	if (lines == nullptr) {
+		arg.term.add_formatted_err("No such buffer: @{}", name);
+		return;
+	}
+	for (const std::string& line : *lines) {
+		arg.term.add_text(line);
+	}
+}
+
+void terminal_commands::count(argument_type& arg) {
+	if (arg.command_line.size() > 1) {
+		arg.term.add_formatted("usage: <command> | {}", arg.command_line[0]);
+		return;
+	}
+	arg.term.add_formatted("{}", arg.input.size());
+}
+
 void terminal_commands::echo(argument_type& arg) {
 	if (arg.command_line.size() < 2) {
 		arg.term.add_formatted("");
@@ -444,12 +564,201 @@ void terminal_commands::exit(argument_type& arg) {
 	arg.term.set_should_close();
 }
 
+void terminal_commands::export_logs(argument_type& arg) {
+	if (arg.command_line.size() == 2 && (arg.command_line[1] == "--help" || arg.command_line[1] == "-help")) {
+		arg.term.add_text(export_args.usage(arg.command_line[0]));
+		arg.term.add_formatted("    all: writes every message");
+		arg.term.add_formatted("    filtered: writes the messages matching the current filter");
+		arg.term.add_formatted("    tagged: prefixes messages with their severity");
+		return;
+	}
+
+	std::string error;
+	auto parsed = export_args.parse(arg.command_line, error);
+	if (!parsed) {
+		arg.term.add_text_err(error);
+		arg.term.add_text_err(export_args.usage(arg.command_line[0]));
+		return;
+	}
+
+	auto [scope, path, tagged] = *parsed;
+	arg.term.export_messages(std::string{path}, tagged ? ImTerm::log_export::format::severity_tagged : ImTerm::log_export::format::plain,
+	                         scope == export_scope::filtered);
+}
+
+void terminal_commands::latency(argument_type& arg) {
+	std::string error;
+	auto parsed = latency_args.parse(arg.command_line, error);
+	if (!parsed) {
+		arg.term.add_text_err(error);
+		arg.term.add_text_err(latency_args.usage(arg.command_line[0]));
+		return;
+	}
+
+	switch (std::get<0>(*parsed)) {
+		case latency_action::off:
+			arg.term.set_latency_tracing(false);
+			return;
+		case latency_action::on:
+			arg.term.set_latency_tracing(true);
+			return;
+		case latency_action::reset:
+			arg.term.reset_display_latency();
+			return;
+		case latency_action::show:
+			break;
+	}
+
+	using std::chrono::microseconds;
+	auto us = [](std::chrono::nanoseconds duration) {
+		return std::chrono::duration_cast<microseconds>(duration).count();
+	};
+	const ImTerm::latency_histogram& histogram = arg.term.display_latency();
+	if (histogram.count() == 0u) {
+		arg.term.add_formatted("No latency measured{}", arg.term.latency_tracing() ? "" : " (tracing is off)");
+		return;
+	}
+	arg.term.add_formatted("{} messages, mean {}us, p50 {}us, p90 {}us, p99 {}us, max {}us, last frame {}us", histogram.count(), us(histogram.mean()),
+	                       us(histogram.percentile(0.5)), us(histogram.percentile(0.9)), us(histogram.percentile(0.99)),
+	                       us(histogram.max()), us(arg.term.last_frame_latency()));
+	for (std::size_t idx = 0 ; idx < ImTerm::latency_histogram::bucket_count ; ++idx) {
+		if (histogram.bucket(idx) == 0u) {
+			continue;
+		}
+		if (idx + 1 < ImTerm::latency_histogram::bucket_count) {
+			arg.term.add_formatted("    < {:>10}us: {}", ImTerm::latency_histogram::bucket_upper_bound(idx).count(), histogram.bucket(idx));
+		} else {
+			arg.term.add_formatted("   >= {:>10}us: {}", ImTerm::latency_histogram::bucket_upper_bound(idx - 1).count(), histogram.bucket(idx));
+		}
+	}
+}
+
+void terminal_commands::limit(argument_type& arg) {
+	if (arg.command_line.size() == 2 && (arg.command_line[1] == "--help" || arg.command_line[1] == "-help")) {
+		arg.term.add_text(limit_args.usage(arg.command_line[0]));
+		arg.term.add_formatted("    messages: maximum number of saved messages");
+		arg.term.add_formatted("    bytes: maximum number of bytes held by saved messages, 0 for no limit");
+		arg.term.add_formatted("    history: maximum number of commands kept in the history, 0 for no limit");
+		return;
+	}
+
+	std::string error;
+	auto parsed = limit_args.parse(arg.command_line, error);
+	if (!parsed) {
+		arg.term.add_text_err(error);
+		return;
+	}
+
+	auto [what, count] = *parsed;
+	switch (what) {
+		case limit_kind::messages:
+			arg.term.set_max_log_len(count);
+			break;
+		case limit_kind::bytes:
+			arg.term.set_max_log_bytes(count);
+			break;
+		case limit_kind::history:
+			arg.term.set_max_history_len(count);
+			break;
+	}
+}
+
+void terminal_commands::time(argument_type& arg) {
+	if (arg.command_line.size() == 2 && (arg.command_line[1] == "--help" || arg.command_line[1] == "-help")) {
+		arg.term.add_text(time_args.usage(arg.command_line[0]));
+		arg.term.add_formatted("    jump <hh:mm[:ss]>: scrolls to the first log at or after the given time of the day");
+		arg.term.add_formatted("    last <seconds>: only shows the logs of the last given seconds");
+		arg.term.add_formatted("    reset: shows logs whatever their time");
+		return;
+	}
+
+	std::string error;
+	auto parsed = time_args.parse(arg.command_line, error);
+	if (!parsed) {
+		arg.term.add_text_err(error);
+		arg.term.add_text_err(time_args.usage(arg.command_line[0]));
+		return;
+	}
+
+	auto [action, value] = *parsed;
+	if (action == time_action::reset) {
+		if (!value.empty()) {
+			arg.term.add_text_err("too many arguments, " + time_args.usage(arg.command_line[0]));
+			return;
+		}
+		arg.term.reset_time_range();
+		return;
+	}
+	if (value.empty()) {
+		arg.term.add_text_err("missing argument <value>");
+		arg.term.add_text_err(time_args.usage(arg.command_line[0]));
+		return;
+	}
+
+	const char* const value_end = value.data() + value.size();
+	if (action == time_action::last) {
+		unsigned int seconds{};
+		auto res = std::from_chars(value.data(), value_end, seconds);
+		if (res.ec != std::errc() || res.ptr != value_end) {
+			arg.term.add_formatted_err("invalid value for <value>: '{}' is not a positive integer", value);
+			arg.term.add_text_err(time_args.usage(arg.command_line[0]));
+			return;
+		}
+		arg.term.set_time_window(std::chrono::seconds{seconds});
+	} else {
+		std::array<int, 3> hms{};
+		const char* ptr = value.data();
+		unsigned int read = 0;
+		while (read < hms.size()) {
+			auto res = std::from_chars(ptr, value_end, hms[read]);
+			if (res.ec != std::errc()) {
+				break;
+			}
+			ptr = res.ptr;
+			++read;
+			if (ptr == value_end || *ptr != ':') {
+				break;
+			}
+			++ptr;
+		}
+		if (read < 2 || ptr != value_end || hms[0] < 0 || hms[0] > 23 || hms[1] < 0 || hms[1] > 59 || hms[2] < 0 || hms[2] > 59) {
+			arg.term.add_formatted_err("invalid value for <value>: '{}' is not a time of the day (hh:mm[:ss])", value);
+			arg.term.add_text_err(time_args.usage(arg.command_line[0]));
+			return;
+		}
+		std::time_t now = std::time(nullptr);
+		std::tm day = *std::localtime(&now);
+		day.tm_hour = hms[0];
+		day.tm_min = hms[1];
+		day.tm_sec = hms[2];
+		day.tm_isdst = -1;
+		arg.term.jump_to_time(std::chrono::system_clock::from_time_t(std::mktime(&day)));
+	}
+}
+
+void terminal_commands::grep(argument_type& arg) {
+	std::string error;
+	auto parsed = grep_args.parse(arg.command_line, error);
+	if (!parsed) {
+		arg.term.add_text_err(error);
+		arg.term.add_text_err(grep_args.usage("<command> | " + arg.command_line[0]));
+		return;
+	}
+
+	const auto [text] = *parsed;
+	for (std::string_view line : arg.input) {
+		if (line.find(text) != std::string_view::npos) {
+			arg.term.add_text(std::string{line});
+		}
+	}
+}
+
 void terminal_commands::help(argument_type& arg) {
-	constexpr unsigned long list_element_name_max_size = misc::max_size(local_command_list.begin(), local_command_list.end(),
+	constexpr unsigned long list_element_name_max_size = misc::max_size(local_commands::begin(), local_commands::end(),
 			[](const command_type& cmd) { return cmd.name.size(); });
 
 	arg.term.add_formatted("Available commands:");
-	for (const command_type& cmd : local_command_list) {
+	for (const command_type& cmd : local_commands::sorted) {
 		arg.term.add_formatted("        {:{}} | {}", cmd.name, list_element_name_max_size, cmd.description);
 	}
 	arg.term.add_formatted("");
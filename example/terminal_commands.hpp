@@ -30,20 +30,27 @@ struct custom_command_struct {
 	bool should_close = false;
 };
 
-class terminal_commands : public ImTerm::basic_spdlog_terminal_helper<terminal_commands, custom_command_struct, misc::no_mutex> {
+class terminal_commands : public ImTerm::basic_spdlog_terminal_helper<terminal_commands, custom_command_struct, std::mutex> {
 public:
 
 	terminal_commands();
 
 	static std::vector<std::string> no_completion(argument_type&) { return {}; }
 
+	static void buffer(argument_type&);
 	static void clear(argument_type&);
 	static void configure_term(argument_type&);
 	static std::vector<std::string> configure_term_autocomplete(argument_type&);
+	static void count(argument_type&);
 	static void echo(argument_type&);
 	static void exit(argument_type&);
+	static void export_logs(argument_type&);
+	static void grep(argument_type&);
 	static void help(argument_type&);
+	static void latency(argument_type&);
+	static void limit(argument_type&);
 	static void quit(argument_type&);
+	static void time(argument_type&);
 };
 
 
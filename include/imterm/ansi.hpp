@@ -0,0 +1,212 @@
+#ifndef IMTERM_ANSI_HPP
+#define IMTERM_ANSI_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <iterator>
+#include <algorithm>
+
+#include "utils.hpp"
+
+namespace ImTerm {
+namespace ansi {
+
+	// color of the given entry of the xterm 256 colors palette, as 0xRRGGBBAA
+	constexpr std::uint32_t palette_color(unsigned int idx) noexcept {
+		constexpr std::uint32_t base_colors[16] = {
+				0x000000FFu, 0xCD0000FFu, 0x00CD00FFu, 0xCDCD00FFu, 0x0000EEFFu, 0xCD00CDFFu, 0x00CDCDFFu, 0xE5E5E5FFu,
+				0x7F7F7FFFu, 0xFF0000FFu, 0x00FF00FFu, 0xFFFF00FFu, 0x5C5CFFFFu, 0xFF00FFFFu, 0x00FFFFFFu, 0xFFFFFFFFu,
+		};
+		constexpr std::uint32_t cube_levels[6] = {0u, 95u, 135u, 175u, 215u, 255u};
+
+		if (idx < 16u) {
+			return base_colors[idx];
+		}
+		if (idx < 232u) {
+			idx -= 16u;
+			return cube_levels[idx / 36u] << 24u | cube_levels[idx / 6u % 6u] << 16u | cube_levels[idx % 6u] << 8u | 0xFFu;
+		}
+		const std::uint32_t gray = 8u + 10u * (std::min(idx, 255u) - 232u);
+		return gray << 24u | gray << 16u | gray << 8u | 0xFFu;
+	}
+
+	inline theme::constexpr_color to_color(std::uint32_t rgba) noexcept {
+		return {static_cast<float>(rgba >> 24u) / 255.f, static_cast<float>(rgba >> 16u & 0xFFu) / 255.f,
+		        static_cast<float>(rgba >> 8u & 0xFFu) / 255.f, static_cast<float>(rgba & 0xFFu) / 255.f};
+	}
+
+	// Removes the ANSI escape sequences from msg.value: control sequences (ESC '[' ... final byte), operating system commands
+	// (ESC ']' ... BEL or ESC '\'), other escape sequences (ESC, intermediate bytes, final byte), and lone ESC characters.
+	// Foreground colors set by SGR sequences ("\x1b[...m") are stored in msg.color_spans, and msg.color_beg/color_end are
+	// moved accordingly. Supported: reset (0), bold (1, 22, brightening the 8 base colors), 30-37, 90-97, 39, 38;5;n and 38;2;r;g;b.
+	// Other attributes (background, underline, ...) are ignored.
+	inline void parse_sgr(message& msg) {
+		std::string& text = msg.value;
+		if (text.find('\x1b') == std::string::npos) {
+			return;
+		}
+
+		constexpr auto npos = std::string::npos;
+		std::string::size_type color_beg = npos;
+		std::string::size_type color_end = npos;
+
+		int base_color = -1; // one of the 8 base colors, brightened when bold
+		bool bold = false;
+		bool has_extended = false; // 38;5;n or 38;2;r;g;b, overriding base_color until reset
+		std::uint32_t extended_color = 0u;
+		std::uint32_t color = 0u;
+		bool has_color = false;
+		std::string::size_type span_beg = 0u;
+
+		std::string::size_type out = 0u;
+		auto set_color = [&](bool new_has_color, std::uint32_t new_color) {
+			if (has_color == new_has_color && (!has_color || color == new_color)) {
+				return;
+			}
+			if (has_color && span_beg < out) {
+				if (!msg.color_spans.empty() && msg.color_spans.back().end == span_beg && msg.color_spans.back().rgba == color) {
+					msg.color_spans.back().end = static_cast<std::uint32_t>(out);
+				} else {
+					msg.color_spans.push_back({static_cast<std::uint32_t>(span_beg), static_cast<std::uint32_t>(out), color});
+				}
+			}
+			has_color = new_has_color;
+			color = new_color;
+			span_beg = out;
+		};
+
+		auto apply_sgr = [&](std::string_view params) {
+			unsigned int values[16];
+			std::size_t count = 0u;
+			unsigned int current = 0u;
+			for (char c : params) {
+				if (c >= '0' && c <= '9') {
+					current = std::min(current * 10u + static_cast<unsigned int>(c - '0'), 0xFFFFu);
+				} else if (c == ';' || c == ':') {
+					if (count < std::size(values)) {
+						values[count++] = current;
+					}
+					current = 0u;
+				}
+			}
+			if (count < std::size(values)) {
+				values[count++] = current; // "\x1b[m" is a reset
+			}
+
+			for (std::size_t i = 0 ; i < count ; ++i) {
+				const unsigned int value = values[i];
+				if (value == 0u) {
+					base_color = -1;
+					bold = false;
+					has_extended = false;
+				} else if (value == 1u) {
+					bold = true;
+				} else if (value == 22u) {
+					bold = false;
+				} else if (value >= 30u && value <= 37u) {
+					base_color = static_cast<int>(value - 30u);
+					has_extended = false;
+				} else if (value >= 90u && value <= 97u) {
+					base_color = static_cast<int>(value - 90u + 8u);
+					has_extended = false;
+				} else if (value == 39u) {
+					base_color = -1;
+					has_extended = false;
+				} else if (value == 38u || value == 48u) {
+					// extended color, also parsed for backgrounds to skip their arguments
+					if (i + 2 < count && values[i + 1] == 5u) {
+						if (value == 38u) {
+							has_extended = true;
+							extended_color = palette_color(std::min(values[i + 2], 255u));
+						}
+						i += 2;
+					} else if (i + 4 < count && values[i + 1] == 2u) {
+						if (value == 38u) {
+							has_extended = true;
+							extended_color = std::min(values[i + 2], 255u) << 24u | std::min(values[i + 3], 255u) << 16u
+							            | std::min(values[i + 4], 255u) << 8u | 0xFFu;
+						}
+						i += 4;
+					}
+				}
+			}
+
+			if (has_extended) {
+				set_color(true, extended_color);
+			} else if (base_color >= 0) {
+				set_color(true, palette_color(static_cast<unsigned int>(bold && base_color < 8 ? base_color + 8 : base_color)));
+			} else {
+				set_color(false, 0u);
+			}
+		};
+
+		std::string::size_type in = 0u;
+		while (in < text.size()) {
+			if (color_beg == npos && in >= msg.color_beg) {
+				color_beg = out;
+			}
+			if (color_end == npos && in >= msg.color_end) {
+				color_end = out;
+			}
+
+			if (text[in] == '\x1b' && in + 1 < text.size() && text[in + 1] == '[') {
+				std::string::size_type final_byte = in + 2;
+				while (final_byte < text.size() && (text[final_byte] < 0x40 || text[final_byte] > 0x7E)) {
+					++final_byte;
+				}
+				if (final_byte < text.size() && text[final_byte] == 'm') {
+					apply_sgr(std::string_view{text.data() + in + 2, final_byte - in - 2});
+				}
+				in = final_byte + 1;
+			} else if (text[in] == '\x1b' && in + 1 < text.size() && text[in + 1] == ']') {
+				// operating system command (window title, hyperlink, ...), ended by BEL or ST (ESC '\')
+				std::string::size_type end = in + 2;
+				while (end < text.size() && text[end] != '\x07' && !(text[end] == '\x1b' && end + 1 < text.size() && text[end + 1] == '\\')) {
+					++end;
+				}
+				in = end >= text.size() ? end : end + (text[end] == '\x07' ? 1u : 2u);
+			} else if (text[in] == '\x1b') {
+				// ESC, intermediate bytes, final byte (ie: "\x1b(B"). A lone ESC is dropped as well
+				std::string::size_type end = in + 1;
+				while (end < text.size() && text[end] >= 0x20 && text[end] <= 0x2F) {
+					++end;
+				}
+				in = end < text.size() && text[end] >= 0x30 && text[end] <= 0x7E ? end + 1 : end;
+			} else {
+				text[out++] = text[in++];
+			}
+		}
+		if (color_beg == npos) {
+			color_beg = out;
+		}
+		if (color_end == npos) {
+			color_end = out;
+		}
+
+		set_color(false, 0u);
+		text.resize(out);
+		msg.color_beg = color_beg;
+		msg.color_end = color_end;
+	}
+}
+}
+
+#endif //IMTERM_ANSI_HPP
@@ -0,0 +1,322 @@
+#ifndef IMTERM_ARGUMENTS_HPP
+#define IMTERM_ARGUMENTS_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "utils.hpp"
+
+// Typed parsing of command arguments, driven by a schema declared at compile time:
+//
+//     enum class unit { bytes, messages };
+//     constexpr ImTerm::args::schema limit_args{
+//             ImTerm::args::choice<unit, 2>{"unit", {{{"bytes", unit::bytes}, {"messages", unit::messages}}}},
+//             ImTerm::args::value<std::size_t>{"count"},
+//             ImTerm::args::defaulted<bool>{"verbose", false},
+//     };
+//
+//     std::string error;
+//     std::optional<std::tuple<unit, std::size_t, bool>> parsed = limit_args.parse(arg.command_line, error);
+//
+// Numbers are converted with std::from_chars, straight from the command line. Text arguments (std::string_view) refer to the
+// command line, without being copied. ImTerm::args::complete<limit_args> can be used as the completion function of the command:
+// it completes the arguments declared with ImTerm::args::choice.
+namespace ImTerm::args {
+
+	// mandatory argument. T may be an integral or floating point type, bool (true/false, on/off, yes/no, 1/0), or std::string_view
+	template <typename T>
+	struct value {
+		using result_type = T;
+		std::string_view name;
+	};
+
+	// optional argument, default_value being used when it is not given. May only be followed by other optional arguments
+	template <typename T>
+	struct defaulted {
+		using result_type = T;
+		std::string_view name;
+		T default_value;
+	};
+
+	// mandatory argument among a fixed set of words, converted to the associated value
+	template <typename Enum, std::size_t N>
+	struct choice {
+		using result_type = Enum;
+		std::string_view name;
+		std::array<std::pair<std::string_view, Enum>, N> choices;
+	};
+
+	// any number of arguments of type T (see value), collected in a vector. May only be the last argument
+	template <typename T>
+	struct variadic {
+		using result_type = std::vector<T>;
+		std::string_view name;
+	};
+
+	namespace details {
+		template <typename Param>
+		struct param_traits {
+			static constexpr bool is_defaulted = false;
+			static constexpr bool is_variadic = false;
+			static constexpr bool is_choice = false;
+		};
+
+		template <typename T>
+		struct param_traits<defaulted<T>> : param_traits<void> {
+			static constexpr bool is_defaulted = true;
+		};
+
+		template <typename T>
+		struct param_traits<variadic<T>> : param_traits<void> {
+			static constexpr bool is_variadic = true;
+		};
+
+		template <typename Enum, std::size_t N>
+		struct param_traits<choice<Enum, N>> : param_traits<void> {
+			static constexpr bool is_choice = true;
+		};
+
+		template <typename T>
+		constexpr std::string_view expected_text() {
+			if constexpr (std::is_same_v<T, bool>) {
+				return "true or false";
+			} else if constexpr (std::is_integral_v<T>) {
+				return std::is_signed_v<T> ? "an integer" : "a positive integer";
+			} else if constexpr (std::is_floating_point_v<T>) {
+				return "a number";
+			} else {
+				return "a text";
+			}
+		}
+
+		// converts str to out, returns false if str is not a valid T
+		template <typename T>
+		bool convert(std::string_view str, T& out, std::errc& ec) {
+			static_assert(std::is_arithmetic_v<T> || std::is_same_v<T, std::string_view>,
+			              "ImTerm::args: arguments may be of arithmetic types or std::string_view");
+			ec = std::errc{};
+			if constexpr (std::is_same_v<T, std::string_view>) {
+				out = str;
+				return true;
+			} else if constexpr (std::is_same_v<T, bool>) {
+				constexpr std::array<std::pair<std::string_view, bool>, 8> words{{
+						{"true", true}, {"false", false}, {"on", true}, {"off", false}, {"yes", true}, {"no", false}, {"1", true}, {"0", false}
+				}};
+				for (const auto& word : words) {
+					if (word.first == str) {
+						out = word.second;
+						return true;
+					}
+				}
+				return false;
+			} else {
+				const char* const end = str.data() + str.size();
+				auto res = std::from_chars(str.data(), end, out);
+				ec = res.ec;
+				return res.ec == std::errc{} && res.ptr == end;
+			}
+		}
+
+		inline void set_invalid_error(std::string& error, std::string_view name, std::string_view given, std::string_view expected) {
+			error = "invalid value for <";
+			error.append(name).append(">: '").append(given).append("' is not ").append(expected);
+		}
+	}
+
+	template <typename... Params>
+	class schema {
+		static constexpr bool is_well_ordered() {
+			constexpr std::array<bool, sizeof...(Params) + 1> defaulted_params{details::param_traits<Params>::is_defaulted..., false};
+			constexpr std::array<bool, sizeof...(Params) + 1> variadic_params{details::param_traits<Params>::is_variadic..., false};
+			bool has_defaulted = false;
+			for (std::size_t i = 0 ; i < sizeof...(Params) ; ++i) {
+				if (variadic_params[i] && (i + 1 != sizeof...(Params) || has_defaulted)) {
+					return false;
+				}
+				if (!defaulted_params[i] && !variadic_params[i] && has_defaulted) {
+					return false;
+				}
+				has_defaulted = has_defaulted || defaulted_params[i];
+			}
+			return true;
+		}
+
+		static_assert(is_well_ordered(), "ImTerm::args::schema: optional arguments must follow mandatory ones, "
+		                                 "and a variadic argument can only be the last one (without optional arguments)");
+
+		static constexpr bool has_variadic = (details::param_traits<Params>::is_variadic || ... || false);
+
+	public:
+		using values_type = std::tuple<typename Params::result_type...>;
+
+		constexpr explicit schema(Params... params) : m_params{params...} {}
+
+		// parses the arguments of command_line (command_line[0] being the command name)
+		// returns an empty optional and sets error to a message describing the problem if they do not match the schema
+		std::optional<values_type> parse(const std::vector<std::string>& command_line, std::string& error) const {
+			const std::size_t given = command_line.empty() ? 0u : command_line.size() - 1;
+			if (!has_variadic && given > sizeof...(Params)) {
+				error = "too many arguments, ";
+				error += usage(command_line.empty() ? std::string_view{} : command_line[0]);
+				return {};
+			}
+
+			values_type values{};
+			if (!parse_all(command_line, values, error, std::index_sequence_for<Params...>{})) {
+				return {};
+			}
+			return {std::move(values)};
+		}
+
+		// returns the usage line of the command, ie: "usage: limit <unit:bytes|messages> <count> [verbose]"
+		std::string usage(std::string_view command_name) const {
+			std::string text{"usage: "};
+			text += command_name;
+			std::apply([&text](const auto&... params) {
+				(append_usage(text, params), ...);
+			}, m_params);
+			return text;
+		}
+
+		// returns the completions of the last word of command_line, if it is an argument declared with 'choice'
+		std::vector<std::string> complete(const std::vector<std::string>& command_line) const {
+			std::vector<std::string> completions;
+			if (command_line.size() < 2) {
+				return completions;
+			}
+			const std::size_t idx = command_line.size() - 2;
+			const std::string_view prefix = command_line.back();
+			complete_all(idx, prefix, completions, std::index_sequence_for<Params...>{});
+			return completions;
+		}
+
+	private:
+		template <std::size_t... Is>
+		bool parse_all(const std::vector<std::string>& command_line, values_type& values, std::string& error, std::index_sequence<Is...>) const {
+			return (parse_one(std::get<Is>(m_params), Is + 1, command_line, std::get<Is>(values), error) && ...);
+		}
+
+		template <typename Param, typename Result>
+		static bool parse_one(const Param& param, std::size_t pos, const std::vector<std::string>& command_line, Result& out, std::string& error) {
+			using traits = details::param_traits<Param>;
+			if constexpr (traits::is_variadic) {
+				out.reserve(command_line.size() > pos ? command_line.size() - pos : 0u);
+				for (; pos < command_line.size() ; ++pos) {
+					if (!convert_one<typename Result::value_type>(param.name, command_line[pos], out.emplace_back(), error)) {
+						return false;
+					}
+				}
+				return true;
+			} else {
+				if (pos >= command_line.size()) {
+					if constexpr (traits::is_defaulted) {
+						out = param.default_value;
+						return true;
+					} else {
+						error = "missing argument <";
+						error.append(param.name).append(">");
+						return false;
+					}
+				}
+
+				if constexpr (traits::is_choice) {
+					for (const auto& choice : param.choices) {
+						if (choice.first == command_line[pos]) {
+							out = choice.second;
+							return true;
+						}
+					}
+					std::string expected{"one of: "};
+					for (const auto& choice : param.choices) {
+						expected.append(choice.first).append(&choice == &param.choices.back() ? "" : ", ");
+					}
+					details::set_invalid_error(error, param.name, command_line[pos], expected);
+					return false;
+				} else {
+					return convert_one<Result>(param.name, command_line[pos], out, error);
+				}
+			}
+		}
+
+		template <typename T>
+		static bool convert_one(std::string_view name, std::string_view str, T& out, std::string& error) {
+			std::errc ec{};
+			if (details::convert(str, out, ec)) {
+				return true;
+			}
+			details::set_invalid_error(error, name, str, ec == std::errc::result_out_of_range ? "in range" : details::expected_text<T>());
+			return false;
+		}
+
+		template <typename Param>
+		static void append_usage(std::string& text, const Param& param) {
+			using traits = details::param_traits<Param>;
+			text += traits::is_defaulted || traits::is_variadic ? " [" : " <";
+			text += param.name;
+			if constexpr (traits::is_choice) {
+				text += ':';
+				for (const auto& choice : param.choices) {
+					text.append(choice.first).append(&choice == &param.choices.back() ? "" : "|");
+				}
+			}
+			text += traits::is_variadic ? "...]" : traits::is_defaulted ? "]" : ">";
+		}
+
+		template <std::size_t... Is>
+		void complete_all(std::size_t idx, std::string_view prefix, std::vector<std::string>& completions, std::index_sequence<Is...>) const {
+			(complete_one(std::get<Is>(m_params), idx == Is, prefix, completions), ...);
+		}
+
+		template <typename Param>
+		static void complete_one(const Param& param, bool is_current, std::string_view prefix, std::vector<std::string>& completions) {
+			if constexpr (details::param_traits<Param>::is_choice) {
+				if (!is_current) {
+					return;
+				}
+				for (const auto& choice : param.choices) {
+					if (choice.first.substr(0, prefix.size()) == prefix) {
+						completions.emplace_back(choice.first);
+					}
+				}
+			}
+		}
+
+		std::tuple<Params...> m_params;
+	};
+
+	template <typename... Params>
+	schema(Params...) -> schema<Params...>;
+
+	// completion function completing the arguments of Schema declared with 'choice' (see command_t::complete)
+	template <const auto& Schema, typename Terminal>
+	std::vector<std::string> complete(argument_t<Terminal>& arg) {
+		return Schema.complete(arg.command_line);
+	}
+}
+
+#endif //IMTERM_ARGUMENTS_HPP
@@ -0,0 +1,177 @@
+#ifndef IMTERM_COMMAND_REGISTRY_HPP
+#define IMTERM_COMMAND_REGISTRY_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <functional>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+
+#include "misc.hpp"
+
+namespace ImTerm {
+
+	// Set of commands that may be modified from any thread while the thread showing the terminal looks them up.
+	// Command is expected to have 'name' and 'description' std::string_view members (see command_t).
+	//
+	// Commands are held by an immutable table: a sorted array (for prefix lookups) and a hash index (for exact lookups).
+	// Writers (add, remove) copy the published table, modify the copy and publish it (read-copy-update), one writer at a time.
+	// The reader (the thread showing the terminal) works on a snapshot of the table, refreshed by synchronize(): lookups never
+	// wait for writers. References returned by lookups stay valid until the next call to synchronize returning true.
+	//
+	// Names and descriptions are copied by the registry: they need not outlive the registered command.
+	template <typename Command>
+	class command_registry {
+	public:
+		using command_cref = std::reference_wrapper<const Command>;
+
+		command_registry() = default;
+
+		command_registry(const command_registry& other) : m_published{std::atomic_load(&other.m_published)} {}
+
+		command_registry(command_registry&& other) noexcept : command_registry(static_cast<const command_registry&>(other)) {}
+
+		command_registry& operator=(const command_registry&) = delete;
+
+		// adds a command, replacing the command of the same name if any. May be called from any thread
+		void add(const Command& cmd) {
+			std::lock_guard<std::mutex> guard{m_write_mutex};
+			auto updated = std::make_shared<table>(*std::atomic_load(&m_published));
+			auto owned = std::make_shared<const owned_strings>(owned_strings{std::string{cmd.name}, std::string{cmd.description}});
+			Command copy = cmd;
+			copy.name = owned->name;
+			copy.description = owned->description;
+
+			auto it = std::lower_bound(updated->commands.begin(), updated->commands.end(), copy.name, [](const Command& lhs, std::string_view rhs) {
+				return lhs.name < rhs;
+			});
+			const auto idx = it - updated->commands.begin();
+			if (it != updated->commands.end() && it->name == copy.name) {
+				*it = copy;
+				updated->strings[static_cast<std::size_t>(idx)] = std::move(owned);
+			} else {
+				updated->commands.insert(it, copy);
+				updated->strings.insert(updated->strings.begin() + idx, std::move(owned));
+			}
+			publish_(std::move(updated));
+		}
+
+		// removes the command of the given name. Returns false if there is none. May be called from any thread
+		bool remove(std::string_view name) {
+			std::lock_guard<std::mutex> guard{m_write_mutex};
+			const std::shared_ptr<const table> current = std::atomic_load(&m_published);
+			auto found = current->by_name.find(name);
+			if (found == current->by_name.end()) {
+				return false;
+			}
+			auto updated = std::make_shared<table>(*current);
+			updated->commands.erase(updated->commands.begin() + static_cast<std::ptrdiff_t>(found->second));
+			updated->strings.erase(updated->strings.begin() + static_cast<std::ptrdiff_t>(found->second));
+			publish_(std::move(updated));
+			return true;
+		}
+
+		// refreshes the snapshot used by lookups if the commands changed since the last call, and returns true in that case.
+		// References previously returned by lookups are invalidated when true is returned. Reader side only
+		bool synchronize() {
+			const std::uint64_t version = m_version.load(std::memory_order_acquire);
+			if (m_snapshot && version == m_snapshot_version) {
+				return false;
+			}
+			m_snapshot = std::atomic_load(&m_published);
+			m_snapshot_version = version;
+			return true;
+		}
+
+		// returns the command of the given name, nullptr if there is none. O(1). Reader side only
+		const Command* find(std::string_view name) {
+			const table& snap = snapshot_();
+			auto found = snap.by_name.find(name);
+			return found == snap.by_name.end() ? nullptr : &snap.commands[found->second];
+		}
+
+		// returns the commands whose name begins with prefix, sorted by name. Reader side only
+		std::vector<command_cref> find_by_prefix(std::string_view prefix) {
+			const table& snap = snapshot_();
+			return misc::prefix_search(prefix, snap.commands.begin(), snap.commands.end(), [](const Command& cmd) { return cmd.name; },
+			                           [](const Command& cmd) { return std::cref(cmd); });
+		}
+
+		// returns every command, sorted by name. Reader side only
+		std::vector<command_cref> list() {
+			const table& snap = snapshot_();
+			return {snap.commands.begin(), snap.commands.end()};
+		}
+
+		// incremented whenever a command is added or removed. May be called from any thread
+		std::uint64_t version() const noexcept {
+			return m_version.load(std::memory_order_acquire);
+		}
+
+	private:
+		struct owned_strings {
+			std::string name;
+			std::string description;
+		};
+
+		struct table {
+			void index_() {
+				by_name.clear();
+				by_name.reserve(commands.size());
+				for (std::size_t i = 0 ; i < commands.size() ; ++i) {
+					by_name.emplace(commands[i].name, i);
+				}
+			}
+
+			std::vector<Command> commands{}; // sorted by name, names and descriptions pointing to strings
+			std::vector<std::shared_ptr<const owned_strings>> strings{}; // shared between the tables holding the same command
+			std::unordered_map<std::string_view, std::size_t> by_name{}; // index in commands
+		};
+
+		// m_write_mutex must be held
+		void publish_(std::shared_ptr<table> updated) {
+			updated->index_();
+			std::atomic_store(&m_published, std::shared_ptr<const table>{std::move(updated)});
+			m_version.fetch_add(1u, std::memory_order_release);
+		}
+
+		const table& snapshot_() {
+			if (!m_snapshot) {
+				synchronize();
+			}
+			return *m_snapshot;
+		}
+
+		std::shared_ptr<const table> m_published{std::make_shared<const table>()}; // only accessed through std::atomic_load and std::atomic_store
+		std::atomic<std::uint64_t> m_version{0u};
+		std::mutex m_write_mutex{};
+
+		// reader side
+		std::shared_ptr<const table> m_snapshot{};
+		std::uint64_t m_snapshot_version{0u};
+	};
+}
+
+#endif //IMTERM_COMMAND_REGISTRY_HPP
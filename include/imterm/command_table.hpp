@@ -0,0 +1,164 @@
+#ifndef IMTERM_COMMAND_TABLE_HPP
+#define IMTERM_COMMAND_TABLE_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace ImTerm {
+	namespace details {
+		constexpr std::uint64_t fnv1a(std::string_view str) noexcept {
+			std::uint64_t hash = 0xcbf29ce484222325u;
+			for (char c : str) {
+				hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3u;
+			}
+			return hash;
+		}
+
+		// smallest power of two holding at least twice count elements, so that hash lookups always end on an empty slot
+		constexpr std::size_t hash_slot_count(std::size_t count) noexcept {
+			std::size_t slots = 1u;
+			while (slots < 2 * count) {
+				slots *= 2;
+			}
+			return slots;
+		}
+
+		// std::sort is not constexpr pre C++20
+		template <typename Command, std::size_t N>
+		constexpr std::array<Command, N> sorted_by_name(std::array<Command, N> commands) noexcept {
+			for (std::size_t i = 1 ; i < N ; ++i) {
+				for (std::size_t j = i ; j > 0 && commands[j].name < commands[j - 1].name ; --j) {
+					Command tmp = commands[j];
+					commands[j] = commands[j - 1];
+					commands[j - 1] = tmp;
+				}
+			}
+			return commands;
+		}
+
+		template <typename Command, std::size_t N>
+		constexpr bool has_duplicated_names(const std::array<Command, N>& sorted_commands) noexcept {
+			for (std::size_t i = 1 ; i < N ; ++i) {
+				if (sorted_commands[i].name == sorted_commands[i - 1].name) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		template <typename Command, std::size_t N>
+		constexpr bool has_empty_names(const std::array<Command, N>& commands) noexcept {
+			for (const Command& cmd : commands) {
+				if (cmd.name.empty()) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// open addressing with linear probing. Slots hold an index in commands + 1, 0 for empty slots
+		template <std::size_t SlotCount, typename Command, std::size_t N>
+		constexpr std::array<std::size_t, SlotCount> hash_slots(const std::array<Command, N>& commands) noexcept {
+			std::array<std::size_t, SlotCount> slots{};
+			for (std::size_t i = 0 ; i < N ; ++i) {
+				std::size_t slot = fnv1a(commands[i].name) & (SlotCount - 1);
+				while (slots[slot] != 0) {
+					slot = (slot + 1) & (SlotCount - 1);
+				}
+				slots[slot] = i + 1;
+			}
+			return slots;
+		}
+	}
+
+	// Command table built at compile time from a constexpr array of commands (see command_t), passed by reference:
+	//     static constexpr std::array cmd_list = {command_type{"clear", ...}, command_type{"echo", ...}};
+	//     using commands = ImTerm::static_command_table<cmd_list>;
+	// Commands are sorted by name at compile time. Duplicated and empty names are rejected by static_assert.
+	// Exact lookups go through a hash table computed at compile time, prefix lookups through a binary search. None of them allocates.
+	template <const auto& Commands>
+	class static_command_table {
+		using array_type = std::remove_cv_t<std::remove_reference_t<decltype(Commands)>>;
+	public:
+		using command_type = typename array_type::value_type;
+		static constexpr std::size_t size = std::tuple_size_v<array_type>;
+
+		static constexpr std::array<command_type, size> sorted = details::sorted_by_name(Commands);
+
+		static_assert(!details::has_empty_names(sorted), "static_command_table: command names must not be empty");
+		static_assert(!details::has_duplicated_names(sorted), "static_command_table: command names must be unique");
+
+		static constexpr const command_type* begin() noexcept {
+			return sorted.data();
+		}
+
+		static constexpr const command_type* end() noexcept {
+			return sorted.data() + size;
+		}
+
+		// returns the command of the given name, nullptr if there is none
+		static constexpr const command_type* find(std::string_view name) noexcept {
+			std::size_t slot = details::fnv1a(name) & (slot_count - 1);
+			while (slots[slot] != 0) {
+				const command_type& cmd = sorted[slots[slot] - 1];
+				if (cmd.name == name) {
+					return &cmd;
+				}
+				slot = (slot + 1) & (slot_count - 1);
+			}
+			return nullptr;
+		}
+
+		// returns the range of commands whose name begins with prefix
+		static constexpr std::pair<const command_type*, const command_type*> find_by_prefix(std::string_view prefix) noexcept {
+			auto first_not_before = [](std::string_view value, auto&& is_before) {
+				std::size_t beg = 0u;
+				std::size_t count = size;
+				while (count > 0) {
+					const std::size_t half = count / 2;
+					if (is_before(sorted[beg + half].name, value)) {
+						beg += half + 1;
+						count -= half + 1;
+					} else {
+						count = half;
+					}
+				}
+				return begin() + beg;
+			};
+			const command_type* lower = first_not_before(prefix, [](std::string_view name, std::string_view pre) {
+				return name < pre;
+			});
+			const command_type* upper = first_not_before(prefix, [](std::string_view name, std::string_view pre) {
+				return name.substr(0, pre.size()) <= pre;
+			});
+			return {lower, upper};
+		}
+
+	private:
+		static constexpr std::size_t slot_count = details::hash_slot_count(size);
+		static constexpr std::array<std::size_t, slot_count> slots = details::hash_slots<slot_count>(sorted);
+	};
+}
+
+#endif //IMTERM_COMMAND_TABLE_HPP
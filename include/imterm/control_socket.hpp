@@ -0,0 +1,408 @@
+#ifndef IMTERM_CONTROL_SOCKET_HPP
+#define IMTERM_CONTROL_SOCKET_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(__unix__) && !defined(__APPLE__)
+#error "ImTerm::control_socket relies on UNIX domain sockets"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "message_store.hpp"
+#include "log_export.hpp"
+
+namespace ImTerm {
+
+	// Local endpoint giving access to the commands and to the messages of a terminal without its window (ie: for headless builds).
+	// Listens on a UNIX domain socket, from a background thread. Clients send command lines, one per line ('\n'), which are
+	// executed by execute_pending, through terminal::execute: they are handled like commands typed by the user.
+	// Two lines are reserved: ".subscribe" streams the messages pushed to the store from then on to the client, one per line,
+	// prefixed by their severity (see log_export::severity_tag), and ".unsubscribe" stops it. Messages whose formatting is deferred
+	// (see message::formatter) and that were not formatted yet are streamed as their raw payload: they are not formatted on the socket thread.
+	//
+	// Messages are read from the store by batches, the store only being locked while they are copied. Each client has its own
+	// send queue: when a client does not read fast enough and its queue is full, new messages are dropped for that client only
+	// (and it is told how many were), so that neither the producers nor the other clients wait for it.
+	//
+	//     ImTerm::control_socket control{term.get_message_store(), "/tmp/my_app.sock", term.get_view_id()};
+	//     while (running) {
+	//         control.execute_pending(term);
+	//         ...
+	//     }
+	class control_socket {
+	public:
+		struct options {
+			std::size_t max_queued_bytes{4u << 20u}; // per client. Messages not fitting in the send queue are dropped for that client
+			std::size_t max_line_length{16u << 10u}; // longer command lines are discarded
+			std::chrono::milliseconds poll_interval{20}; // delay between two checks for new messages
+		};
+
+		// listens on path. A stale socket at path is replaced, any other file is left alone
+		// terminal messages (see message::is_term_message) are only streamed if they were emitted by view, unless view is no_view
+		// if the socket cannot be created, an error message is pushed to the store and listening() returns false
+		control_socket(std::shared_ptr<message_store> store, std::string path, message_store::view_id view = message_store::no_view)
+			: control_socket(std::move(store), std::move(path), view, options{}) {}
+
+		control_socket(std::shared_ptr<message_store> store, std::string path, message_store::view_id view, options opts)
+			: m_store{std::move(store)}
+			, m_path{std::move(path)}
+			, m_view{view}
+			, m_options{opts} {
+			if (!open_()) {
+				const int error = errno;
+				message msg{message::severity::err, "control socket: cannot listen on " + m_path + ": " + std::strerror(error), 0u, 0u, false};
+				m_store->push(std::move(msg));
+				close_fds_();
+				return;
+			}
+			m_store->lock();
+			m_next_seq = m_store->end_seq();
+			m_store->unlock();
+			m_thread = std::thread{&control_socket::run, this};
+		}
+
+		control_socket(const control_socket&) = delete;
+		control_socket& operator=(const control_socket&) = delete;
+
+		// disconnects the clients, waits for the background thread and removes the socket file
+		~control_socket() {
+			if (m_thread.joinable()) {
+				m_stopped.store(true, std::memory_order_relaxed);
+				wake_();
+				m_thread.join();
+				::unlink(m_path.c_str());
+			}
+			close_fds_();
+		}
+
+		bool listening() const noexcept {
+			return m_listen_fd >= 0;
+		}
+
+		const std::string& path() const noexcept {
+			return m_path;
+		}
+
+		std::size_t client_count() const noexcept {
+			return m_client_count.load(std::memory_order_relaxed);
+		}
+
+		// executes the command lines received since the last call with term.execute, in order, and returns how many there were
+		// to be called from the thread using the terminal
+		template <typename Terminal>
+		std::size_t execute_pending(Terminal& term) {
+			std::vector<std::string> lines;
+			{
+				std::lock_guard<std::mutex> guard{m_pending_mutex};
+				lines.swap(m_pending);
+			}
+			for (const std::string& line : lines) {
+				term.execute(line);
+			}
+			return lines.size();
+		}
+
+	private:
+		static constexpr std::size_t batch_size = 256u;
+
+		struct client {
+			int fd;
+			std::string input{}; // received bytes not forming a full line yet
+			std::deque<std::string> output{}; // frames to be sent
+			std::size_t sent{0u}; // bytes of output.front() already sent
+			std::size_t queued_bytes{0u};
+			std::size_t dropped{0u}; // messages dropped since the last frame
+			bool subscribed{false};
+			bool closed{false};
+		};
+
+		static bool set_flags_(int fd) noexcept {
+			return ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK) == 0 && ::fcntl(fd, F_SETFD, FD_CLOEXEC) == 0;
+		}
+
+		bool open_() noexcept {
+			sockaddr_un addr{};
+			addr.sun_family = AF_UNIX;
+			if (m_path.empty() || m_path.size() >= sizeof(addr.sun_path)) {
+				errno = ENAMETOOLONG;
+				return false;
+			}
+			std::memcpy(addr.sun_path, m_path.c_str(), m_path.size() + 1);
+
+			struct stat st{};
+			if (::stat(m_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+				::unlink(m_path.c_str());
+			}
+
+			m_listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+			if (m_listen_fd < 0 || !set_flags_(m_listen_fd)
+			    || ::bind(m_listen_fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(m_listen_fd, 16) != 0) {
+				return false;
+			}
+
+			int wake[2];
+			if (::pipe(wake) != 0) {
+				return false;
+			}
+			m_wake_read_fd = wake[0];
+			m_wake_write_fd = wake[1];
+			return set_flags_(m_wake_read_fd) && set_flags_(m_wake_write_fd);
+		}
+
+		void close_fds_() noexcept {
+			for (int* fd : {&m_listen_fd, &m_wake_read_fd, &m_wake_write_fd}) {
+				if (*fd >= 0) {
+					::close(*fd);
+					*fd = -1;
+				}
+			}
+		}
+
+		void wake_() noexcept {
+			const char c = 0;
+			[[maybe_unused]] auto ignored = ::write(m_wake_write_fd, &c, 1);
+		}
+
+		void run() {
+			std::vector<client> clients;
+			std::vector<pollfd> fds;
+			while (!m_stopped.load(std::memory_order_relaxed)) {
+				fds.clear();
+				fds.push_back({m_wake_read_fd, POLLIN, 0});
+				fds.push_back({m_listen_fd, POLLIN, 0});
+				for (const client& c : clients) {
+					fds.push_back({c.fd, static_cast<short>(c.output.empty() ? POLLIN : POLLIN | POLLOUT), 0});
+				}
+				::poll(fds.data(), static_cast<nfds_t>(fds.size()), static_cast<int>(m_options.poll_interval.count()));
+
+				if (fds[0].revents & POLLIN) {
+					char drain[64];
+					while (::read(m_wake_read_fd, drain, sizeof(drain)) > 0) {}
+				}
+				for (std::size_t i = 0 ; i < clients.size() ; ++i) {
+					if (fds[i + 2].revents & (POLLIN | POLLHUP | POLLERR)) {
+						receive_(clients[i]);
+					}
+				}
+				if (fds[1].revents & POLLIN) {
+					accept_(clients);
+				}
+
+				stream_(clients);
+				for (client& c : clients) {
+					send_(c);
+				}
+
+				clients.erase(std::remove_if(clients.begin(), clients.end(), [](const client& c) {
+					if (c.closed) {
+						::close(c.fd);
+					}
+					return c.closed;
+				}), clients.end());
+				m_client_count.store(clients.size(), std::memory_order_relaxed);
+			}
+
+			for (const client& c : clients) {
+				::close(c.fd);
+			}
+			m_client_count.store(0u, std::memory_order_relaxed);
+		}
+
+		void accept_(std::vector<client>& clients) {
+			int fd;
+			while ((fd = ::accept(m_listen_fd, nullptr, nullptr)) >= 0) {
+				if (!set_flags_(fd)) {
+					::close(fd);
+					continue;
+				}
+#ifdef SO_NOSIGPIPE
+				int one = 1;
+				::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+				clients.push_back(client{fd});
+			}
+		}
+
+		void receive_(client& c) {
+			char buffer[4096];
+			ssize_t count;
+			while ((count = ::read(c.fd, buffer, sizeof(buffer))) > 0) {
+				c.input.append(buffer, static_cast<std::size_t>(count));
+			}
+			if (count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+				c.closed = true;
+			}
+
+			std::string::size_type line_beg = 0u;
+			std::string::size_type line_end;
+			std::vector<std::string> lines;
+			while ((line_end = c.input.find('\n', line_beg)) != std::string::npos) {
+				std::string_view line{c.input.data() + line_beg, line_end - line_beg};
+				line_beg = line_end + 1;
+				if (!line.empty() && line.back() == '\r') {
+					line.remove_suffix(1);
+				}
+
+				if (line == ".subscribe") {
+					c.subscribed = true;
+				} else if (line == ".unsubscribe") {
+					c.subscribed = false;
+				} else if (!line.empty() && line.size() <= m_options.max_line_length) {
+					lines.emplace_back(line);
+				}
+			}
+			c.input.erase(0, line_beg);
+			if (c.input.size() > m_options.max_line_length) {
+				c.input.clear(); // the rest of the line will be discarded as well, as it won't be a full line
+			}
+
+			if (!lines.empty()) {
+				std::lock_guard<std::mutex> guard{m_pending_mutex};
+				m_pending.insert(m_pending.end(), std::make_move_iterator(lines.begin()), std::make_move_iterator(lines.end()));
+			}
+		}
+
+		// copies the messages pushed since the last call, by batches, and queues them to the subscribed clients
+		// stops early once every subscribed client has a well filled queue: the remaining messages are read at the next iteration,
+		// so that the fastest client is not made to drop messages by a burst
+		void stream_(std::vector<client>& clients) {
+			const bool has_subscribers = std::any_of(clients.begin(), clients.end(), [](const client& c) { return c.subscribed; });
+			auto has_room = [this](const client& c) {
+				return c.subscribed && !c.closed && c.queued_bytes < m_options.max_queued_bytes / 2;
+			};
+
+			std::string frame;
+			while (!has_subscribers || std::any_of(clients.begin(), clients.end(), has_room)) {
+				frame.clear();
+				std::size_t message_count = 0u;
+
+				m_store->lock();
+				const message_store::seq_type end = m_store->end_seq();
+				if (!has_subscribers || m_next_seq >= end) {
+					m_next_seq = end;
+					m_store->unlock();
+					return;
+				}
+				if (m_next_seq < m_store->first_seq()) {
+					frame += "[control] " + std::to_string(m_store->first_seq() - m_next_seq) + " messages were evicted before being sent\n";
+					m_next_seq = m_store->first_seq();
+				}
+				const message_store::seq_type batch_end = std::min<message_store::seq_type>(end, m_next_seq + batch_size);
+				for (; m_next_seq < batch_end ; ++m_next_seq) {
+					const message& msg = m_store->at(m_next_seq);
+					if (msg.is_term_message && m_view != message_store::no_view && m_store->origin(m_next_seq) != m_view) {
+						continue;
+					}
+					frame += log_export::severity_tag(msg);
+					frame += msg.value;
+					if (msg.repeat_count > 1) {
+						frame += " (x" + std::to_string(msg.repeat_count) + ")";
+					}
+					frame += '\n';
+					++message_count;
+				}
+				m_store->unlock();
+
+				for (client& c : clients) {
+					if (c.subscribed) {
+						queue_(c, frame, message_count);
+						send_(c);
+					}
+				}
+			}
+		}
+
+		void queue_(client& c, const std::string& frame, std::size_t message_count) {
+			if (frame.empty()) {
+				return;
+			}
+			if (!c.output.empty() && c.queued_bytes + frame.size() > m_options.max_queued_bytes) {
+				c.dropped += message_count;
+				return;
+			}
+			if (c.dropped > 0u) {
+				c.output.emplace_back("[control] " + std::to_string(c.dropped) + " messages dropped, client too slow\n");
+				c.queued_bytes += c.output.back().size();
+				c.dropped = 0u;
+			}
+			c.output.push_back(frame);
+			c.queued_bytes += frame.size();
+		}
+
+		void send_(client& c) {
+#ifdef MSG_NOSIGNAL
+			constexpr int flags = MSG_NOSIGNAL;
+#else
+			constexpr int flags = 0;
+#endif
+			while (!c.closed && !c.output.empty()) {
+				const std::string& frame = c.output.front();
+				const ssize_t count = ::send(c.fd, frame.data() + c.sent, frame.size() - c.sent, flags);
+				if (count < 0) {
+					c.closed = errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR;
+					return;
+				}
+				c.sent += static_cast<std::size_t>(count);
+				if (c.sent == frame.size()) {
+					c.queued_bytes -= frame.size();
+					c.sent = 0u;
+					c.output.pop_front();
+				}
+			}
+		}
+
+		std::shared_ptr<message_store> m_store;
+		std::string m_path;
+		message_store::view_id m_view;
+		options m_options;
+
+		int m_listen_fd{-1};
+		int m_wake_read_fd{-1};
+		int m_wake_write_fd{-1};
+
+		std::mutex m_pending_mutex{};
+		std::vector<std::string> m_pending{}; // guarded by m_pending_mutex
+
+		message_store::seq_type m_next_seq{0u}; // background thread only, once started
+		std::atomic<std::size_t> m_client_count{0u};
+		std::atomic<bool> m_stopped{false};
+
+		std::thread m_thread{}; // started last, so that everything is initialized when the thread starts
+	};
+}
+
+#endif //IMTERM_CONTROL_SOCKET_HPP
@@ -0,0 +1,226 @@
+#ifndef IMTERM_FILE_TAIL_HPP
+#define IMTERM_FILE_TAIL_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+
+#if __has_include(<sys/stat.h>)
+#include <sys/stat.h>
+#define IMTERM_FILE_TAIL_HAS_STAT
+#endif
+
+#include "message_store.hpp"
+
+namespace ImTerm {
+
+	// Streams the lines appended to a local file (a log file written by another process, typically) into a message store.
+	// poll() is to be called regularly, for instance once per frame. It reads the file by large blocks, up to a maximum number
+	// of bytes per call, and pushes the complete lines it read all at once (see message_store::push_bulk).
+	// Truncated files are read again from their beginning. Replaced files (log rotation) are read until their end, then the new file
+	// is opened (detection of replaced files requires <sys/stat.h>, a replaced file being otherwise only detected if it is smaller).
+	class file_tail {
+	public:
+		struct options {
+			message::severity::severity_t severity{message::severity::info}; // severity of the read lines
+			std::string channel{}; // channel of the read lines (see message_store::channel)
+			bool from_beginning{false}; // if false, lines that were in the file before it was first opened are not read
+			std::size_t block_size{64 * 1024}; // size of each read
+			std::size_t max_bytes_per_poll{1024 * 1024}; // maximum number of bytes read by a call to poll(), 0 for no limit
+			std::size_t max_line_length{64 * 1024}; // longer lines are split in several messages, 0 for no limit
+		};
+
+		file_tail(std::shared_ptr<message_store> store, std::string path) : file_tail(std::move(store), std::move(path), options{}) {}
+
+		file_tail(std::shared_ptr<message_store> store, std::string path, options opts)
+			: m_store{std::move(store)}
+			, m_path{std::move(path)}
+			, m_options{std::move(opts)}
+			, m_block(std::max<std::size_t>(m_options.block_size, 1u)) {
+			m_channel = m_store->channel(m_options.channel);
+			open(!m_options.from_beginning);
+		}
+
+		file_tail(const file_tail&) = delete;
+		file_tail& operator=(const file_tail&) = delete;
+
+		// reads the lines appended to the file since the last call, and pushes them to the message store
+		// returns the number of pushed lines
+		std::size_t poll() {
+			if (!m_file.is_open() && !open(false)) {
+				return 0u;
+			}
+
+			file_status status = stat(m_path);
+			bool replaced = status.exists && m_status.exists && (status.device != m_status.device || status.inode != m_status.inode);
+			if (!replaced && status.exists && status.size < m_offset) { // truncated
+				open(false);
+			}
+
+			std::size_t budget = m_options.max_bytes_per_poll == 0u ? ~std::size_t{0u} : m_options.max_bytes_per_poll;
+			while (budget > 0u) {
+				const std::size_t to_read = std::min(budget, m_block.size());
+				m_file.read(m_block.data(), static_cast<std::streamsize>(to_read));
+				const auto read = static_cast<std::size_t>(m_file.gcount());
+				split_lines(m_block.data(), m_block.data() + read);
+				m_offset += read;
+				budget -= read;
+
+				if (read < to_read) { // end of file
+					m_file.clear();
+					if (replaced) {
+						flush_partial_line();
+						open(false);
+						replaced = false;
+						continue;
+					}
+					break;
+				}
+			}
+
+			const std::size_t count = m_batch.size();
+			if (count > 0u) {
+				m_store->push_bulk(m_batch);
+				m_batch.clear();
+			}
+			return count;
+		}
+
+		const std::string& path() const noexcept {
+			return m_path;
+		}
+
+		bool is_open() const noexcept {
+			return m_file.is_open();
+		}
+
+	private:
+		struct file_status {
+			bool exists;
+			std::uint64_t size;
+			std::uint64_t device;
+			std::uint64_t inode;
+		};
+
+		static file_status stat(const std::string& path) noexcept {
+#ifdef IMTERM_FILE_TAIL_HAS_STAT
+			struct ::stat st{};
+			if (::stat(path.c_str(), &st) != 0) {
+				return {false, 0u, 0u, 0u};
+			}
+			return {true, static_cast<std::uint64_t>(st.st_size), static_cast<std::uint64_t>(st.st_dev), static_cast<std::uint64_t>(st.st_ino)};
+#else
+			std::error_code ec;
+			const std::uintmax_t size = std::filesystem::file_size(path, ec);
+			return {!ec, ec ? 0u : static_cast<std::uint64_t>(size), 0u, 0u};
+#endif
+		}
+
+		bool open(bool at_end) {
+			m_file.close();
+			m_file.clear();
+			m_partial_line.clear();
+			m_offset = 0u;
+			m_file.open(m_path, std::ios::in | std::ios::binary);
+			if (!m_file.is_open()) {
+				m_status = {false, 0u, 0u, 0u};
+				return false;
+			}
+			m_status = stat(m_path);
+			if (at_end) {
+				m_file.seekg(0, std::ios::end);
+				m_offset = static_cast<std::uint64_t>(m_file.tellg());
+			}
+			return true;
+		}
+
+		void split_lines(const char* beg, const char* end) {
+			// memchr is usually vectorized
+			while (const char* new_line = static_cast<const char*>(std::memchr(beg, '\n', static_cast<std::size_t>(end - beg)))) {
+				if (m_partial_line.empty()) {
+					add_line(beg, new_line);
+				} else {
+					m_partial_line.append(beg, new_line);
+					add_line(m_partial_line.data(), m_partial_line.data() + m_partial_line.size());
+					m_partial_line.clear();
+				}
+				beg = new_line + 1;
+			}
+			m_partial_line.append(beg, end);
+			const std::size_t max_length = m_options.max_line_length;
+			if (max_length != 0u && m_partial_line.size() > max_length) {
+				// at most max_length characters (and a carriage return) are kept, to be completed by the next block
+				const std::size_t length = m_partial_line.size() - (m_partial_line.back() == '\r' ? 1u : 0u);
+				const std::size_t cut = length == 0u ? 0u : (length - 1u) / max_length * max_length;
+				for (std::size_t pos = 0 ; pos < cut ; pos += max_length) {
+					add_message(m_partial_line.data() + pos, m_partial_line.data() + pos + max_length);
+				}
+				m_partial_line.erase(0, cut);
+			}
+		}
+
+		void flush_partial_line() {
+			if (!m_partial_line.empty()) {
+				add_line(m_partial_line.data(), m_partial_line.data() + m_partial_line.size());
+				m_partial_line.clear();
+			}
+		}
+
+		// lines longer than options::max_line_length are split in several messages
+		void add_line(const char* beg, const char* end) {
+			if (end != beg && end[-1] == '\r') {
+				--end;
+			}
+			const std::size_t max_length = m_options.max_line_length;
+			while (max_length != 0u && static_cast<std::size_t>(end - beg) > max_length) {
+				add_message(beg, beg + max_length);
+				beg += max_length;
+			}
+			add_message(beg, end);
+		}
+
+		void add_message(const char* beg, const char* end) {
+			message& msg = m_batch.emplace_back(message{m_options.severity, std::string{beg, end}, 0u, 0u, false});
+			msg.channel = m_channel;
+		}
+
+		std::shared_ptr<message_store> m_store;
+		std::string m_path;
+		options m_options;
+		message::channel_id m_channel{message::default_channel};
+
+		std::ifstream m_file{};
+		file_status m_status{false, 0u, 0u, 0u};
+		std::uint64_t m_offset{0u};
+
+		std::vector<char> m_block;
+		std::string m_partial_line{};
+		std::vector<message> m_batch{};
+	};
+}
+
+#undef IMTERM_FILE_TAIL_HAS_STAT
+
+#endif //IMTERM_FILE_TAIL_HPP
@@ -0,0 +1,166 @@
+#ifndef IMTERM_FILE_WRITER_HPP
+#define IMTERM_FILE_WRITER_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ImTerm {
+
+	// Writes lines to a file from a background thread (used by "command > file" and "command >> file").
+	// Lines are queued by batches: the thread producing them never waits for the file.
+	// A writer may serve several redirections to the same file (see truncate), until it is closed.
+	// Failures to open or write to the file are not reported by the writer itself, see failed.
+	class file_writer {
+	public:
+		// number of lines the terminal gathers before queuing them
+		static constexpr std::size_t batch_size = 1024u;
+
+		// opens the file at path, truncating it unless append is true
+		file_writer(std::string path, bool append)
+			: m_path{std::move(path)}
+			, m_append{append}
+			, m_thread{&file_writer::run, this} {}
+
+		file_writer(const file_writer&) = delete;
+		file_writer& operator=(const file_writer&) = delete;
+
+		~file_writer() {
+			wait();
+		}
+
+		// queues lines to be written, each one followed by a new line
+		void write(std::vector<std::string> lines) {
+			if (lines.empty()) {
+				return;
+			}
+			{
+				std::lock_guard<std::mutex> guard{m_mutex};
+				m_queue.push_back({std::move(lines), false});
+			}
+			m_cv.notify_one();
+		}
+
+		// the lines queued next are written from the beginning of the file, which is emptied
+		void truncate() {
+			{
+				std::lock_guard<std::mutex> guard{m_mutex};
+				m_queue.push_back({{}, true});
+			}
+			m_cv.notify_one();
+		}
+
+		// no more lines will be written: the file is closed once the queued lines are written
+		void close() {
+			{
+				std::lock_guard<std::mutex> guard{m_mutex};
+				m_closed = true;
+			}
+			m_cv.notify_one();
+		}
+
+		// closes the writer, and waits for the remaining lines to be written
+		void wait() {
+			close();
+			if (m_thread.joinable()) {
+				m_thread.join();
+			}
+		}
+
+		bool closed() const {
+			std::lock_guard<std::mutex> guard{m_mutex};
+			return m_closed;
+		}
+
+		bool done() const noexcept {
+			return m_done.load(std::memory_order_acquire);
+		}
+
+		// the file could not be opened or written to (some lines may be missing)
+		bool failed() const noexcept {
+			return m_failed.load(std::memory_order_relaxed);
+		}
+
+		const std::string& path() const noexcept {
+			return m_path;
+		}
+
+	private:
+		struct batch {
+			std::vector<std::string> lines;
+			bool truncate; // lines is empty, the file is reopened and emptied
+		};
+
+		void run() {
+			std::ofstream file{m_path, std::ios::out | std::ios::binary | (m_append ? std::ios::app : std::ios::trunc)};
+
+			std::vector<batch> batches;
+			std::string buffer;
+			bool closed = false;
+			while (!closed) {
+				{
+					std::unique_lock<std::mutex> lock{m_mutex};
+					m_cv.wait(lock, [this]() { return m_closed || !m_queue.empty(); });
+					batches.swap(m_queue);
+					closed = m_closed;
+				}
+
+				for (const batch& queued : batches) {
+					if (queued.truncate) {
+						file.close();
+						file.open(m_path, std::ios::out | std::ios::binary | std::ios::trunc);
+						continue;
+					}
+					buffer.clear();
+					for (const std::string& line : queued.lines) {
+						buffer += line;
+						buffer += '\n';
+					}
+					file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+				}
+				batches.clear();
+				file.flush();
+				if (!file) {
+					m_failed.store(true, std::memory_order_relaxed);
+				}
+			}
+			m_done.store(true, std::memory_order_release);
+		}
+
+		std::string m_path;
+		bool m_append;
+
+		mutable std::mutex m_mutex{};
+		std::condition_variable m_cv{};
+		std::vector<batch> m_queue{}; // guarded by m_mutex
+		bool m_closed{false}; // guarded by m_mutex
+		std::atomic<bool> m_failed{false};
+		std::atomic<bool> m_done{false};
+
+		std::thread m_thread; // last, so that everything is initialized when the thread starts
+	};
+}
+
+#endif //IMTERM_FILE_WRITER_HPP
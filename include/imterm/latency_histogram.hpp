@@ -0,0 +1,102 @@
+#ifndef IMTERM_LATENCY_HISTOGRAM_HPP
+#define IMTERM_LATENCY_HISTOGRAM_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+namespace ImTerm {
+
+	// Histogram of durations, with one bucket per power of two of microseconds: bucket 0 counts durations below 1µs,
+	// bucket n durations in [2^(n-1), 2^n)µs, the last bucket counting every longer duration.
+	// Recording is a few instructions and never allocates. Not thread safe.
+	class latency_histogram {
+	public:
+		static constexpr std::size_t bucket_count = 32u;
+
+		void record(std::chrono::nanoseconds latency) noexcept {
+			if (latency.count() < 0) {
+				latency = std::chrono::nanoseconds{0};
+			}
+			const auto us = static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+			std::size_t idx = 0u;
+			while (idx + 1 < bucket_count && (us >> idx) != 0u) {
+				++idx;
+			}
+			++m_buckets[idx];
+			++m_count;
+			m_total += latency;
+			m_max = std::max(m_max, latency);
+		}
+
+		unsigned long long count() const noexcept {
+			return m_count;
+		}
+
+		// number of durations recorded in bucket idx (see bucket_upper_bound)
+		unsigned long long bucket(std::size_t idx) const noexcept {
+			return m_buckets[idx];
+		}
+
+		// durations counted by bucket idx are lower than this bound (the last bucket has none)
+		static std::chrono::microseconds bucket_upper_bound(std::size_t idx) noexcept {
+			return idx + 1 < bucket_count ? std::chrono::microseconds{1ll << idx} : std::chrono::microseconds::max();
+		}
+
+		std::chrono::nanoseconds max() const noexcept {
+			return m_max;
+		}
+
+		std::chrono::nanoseconds mean() const noexcept {
+			return m_count == 0u ? std::chrono::nanoseconds{0} : m_total / static_cast<std::chrono::nanoseconds::rep>(m_count);
+		}
+
+		// upper bound of the bucket holding the q-th quantile (0 <= q <= 1), capped by the longest recorded duration
+		// 0 if nothing was recorded
+		std::chrono::nanoseconds percentile(double q) const noexcept {
+			if (m_count == 0u) {
+				return std::chrono::nanoseconds{0};
+			}
+			const auto rank = static_cast<unsigned long long>(std::clamp(q, 0., 1.) * static_cast<double>(m_count - 1));
+			unsigned long long seen = 0u;
+			for (std::size_t idx = 0 ; idx + 1 < bucket_count ; ++idx) {
+				seen += m_buckets[idx];
+				if (seen > rank) {
+					return std::min<std::chrono::nanoseconds>(bucket_upper_bound(idx), m_max);
+				}
+			}
+			return m_max;
+		}
+
+		void reset() noexcept {
+			*this = latency_histogram{};
+		}
+
+	private:
+		std::array<unsigned long long, bucket_count> m_buckets{};
+		unsigned long long m_count{0u};
+		std::chrono::nanoseconds m_total{0};
+		std::chrono::nanoseconds m_max{0};
+	};
+}
+
+#endif //IMTERM_LATENCY_HISTOGRAM_HPP
@@ -0,0 +1,188 @@
+#ifndef IMTERM_LOG_EXPORT_HPP
+#define IMTERM_LOG_EXPORT_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "message_store.hpp"
+
+namespace ImTerm {
+
+	// Writes stored messages to a file, from a background thread.
+	// The messages to be written are given by their sequence numbers, which makes the snapshot cheap to take.
+	// The store is only locked while copying small batches of messages, so neither producers nor terminals are stalled.
+	// Messages evicted from the store before being written are skipped (see progress::skipped).
+	class log_export {
+	public:
+		enum class format {
+			plain,           // one line per message, as displayed
+			severity_tagged, // same, prefixed by "[severity] "
+		};
+
+		struct progress {
+			std::size_t written;         // number of messages written so far
+			std::size_t skipped;         // number of messages evicted from the store before being written
+			std::size_t total;           // number of messages to be written
+			unsigned long long bytes;    // number of bytes written so far
+			std::chrono::duration<double> elapsed;
+			bool done;
+			bool failed;                 // the file could not be opened or written to
+
+			// bytes per second
+			double throughput() const noexcept {
+				return elapsed.count() > 0. ? static_cast<double>(bytes) / elapsed.count() : 0.;
+			}
+		};
+
+		// starts writing the messages whose sequence numbers are given (sorted) to the file at path
+		log_export(std::shared_ptr<message_store> store, std::vector<message_store::seq_type> seqs, std::string path, format fmt)
+			: m_store{std::move(store)}
+			, m_seqs{std::move(seqs)}
+			, m_path{std::move(path)}
+			, m_format{fmt}
+			, m_start{std::chrono::steady_clock::now()}
+			, m_thread{&log_export::run, this} {}
+
+		log_export(const log_export&) = delete;
+		log_export& operator=(const log_export&) = delete;
+
+		// cancels the export if it is still running, and waits for the background thread
+		~log_export() {
+			cancel();
+			m_thread.join();
+		}
+
+		void cancel() noexcept {
+			m_cancelled.store(true, std::memory_order_relaxed);
+		}
+
+		bool done() const noexcept {
+			return m_done.load(std::memory_order_acquire);
+		}
+
+		const std::string& path() const noexcept {
+			return m_path;
+		}
+
+		progress get_progress() const noexcept {
+			progress p{};
+			p.done = done();
+			p.written = m_written.load(std::memory_order_relaxed);
+			p.skipped = m_skipped.load(std::memory_order_relaxed);
+			p.total = m_seqs.size();
+			p.bytes = m_bytes.load(std::memory_order_relaxed);
+			p.failed = m_failed.load(std::memory_order_relaxed);
+			p.elapsed = p.done ? m_elapsed : std::chrono::steady_clock::now() - m_start;
+			return p;
+		}
+
+		// a line summing up the export (messages and bytes written, throughput, failure...), once done
+		std::string summary() const {
+			progress p = get_progress();
+			if (p.failed) {
+				return "export to " + m_path + " failed";
+			}
+			std::string text = "exported " + std::to_string(p.written) + " messages (" + std::to_string(p.bytes / 1024u) + " KiB) to " + m_path
+			                   + " in " + std::to_string(static_cast<long long>(p.elapsed.count() * 1000.)) + " ms ("
+			                   + std::to_string(static_cast<long long>(p.throughput() / (1024. * 1024.))) + " MiB/s)";
+			if (p.skipped > 0u) {
+				text += ", " + std::to_string(p.skipped) + " messages were evicted before being written";
+			}
+			if (p.written + p.skipped < p.total) {
+				text += ", cancelled";
+			}
+			return text;
+		}
+
+		static constexpr std::string_view severity_tag(const message& msg) noexcept {
+			constexpr std::string_view tags[] = {"[trace] ", "[debug] ", "[info] ", "[warning] ", "[error] ", "[critical] "};
+			return msg.is_term_message ? std::string_view{"[terminal] "} : tags[msg.severity];
+		}
+
+	private:
+		static constexpr std::size_t batch_size = 256u;
+
+		void run() {
+			std::ofstream file{m_path, std::ios::out | std::ios::trunc | std::ios::binary};
+			m_failed.store(!file, std::memory_order_relaxed);
+
+			std::string buffer;
+			for (std::size_t beg = 0 ; file && beg < m_seqs.size() && !m_cancelled.load(std::memory_order_relaxed) ; beg += batch_size) {
+				const std::size_t end = std::min(beg + batch_size, m_seqs.size());
+
+				buffer.clear();
+				std::size_t skipped = 0u;
+				m_store->lock();
+				for (std::size_t i = beg ; i < end ; ++i) {
+					if (m_seqs[i] < m_store->first_seq()) {
+						++skipped;
+						continue;
+					}
+					const message& msg = m_store->formatted(m_seqs[i]);
+					if (m_format == format::severity_tagged) {
+						buffer += severity_tag(msg);
+					}
+					buffer += msg.value;
+					if (msg.repeat_count > 1) {
+						buffer += " (x" + std::to_string(msg.repeat_count) + ")";
+					}
+					buffer += '\n';
+				}
+				m_store->unlock();
+
+				file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+				m_written.fetch_add(end - beg - skipped, std::memory_order_relaxed);
+				m_skipped.fetch_add(skipped, std::memory_order_relaxed);
+				m_bytes.fetch_add(buffer.size(), std::memory_order_relaxed);
+			}
+			file.flush();
+			if (!file) {
+				m_failed.store(true, std::memory_order_relaxed);
+			}
+
+			m_elapsed = std::chrono::steady_clock::now() - m_start;
+			m_done.store(true, std::memory_order_release);
+		}
+
+		std::shared_ptr<message_store> m_store;
+		std::vector<message_store::seq_type> m_seqs;
+		std::string m_path;
+		format m_format;
+
+		std::atomic<std::size_t> m_written{0u};
+		std::atomic<std::size_t> m_skipped{0u};
+		std::atomic<unsigned long long> m_bytes{0u};
+		std::atomic<bool> m_failed{false};
+		std::atomic<bool> m_cancelled{false};
+		std::atomic<bool> m_done{false};
+		const std::chrono::steady_clock::time_point m_start;
+		std::chrono::duration<double> m_elapsed{}; // set before m_done
+
+		std::thread m_thread; // last, so that everything is initialized when the thread starts
+	};
+}
+
+#endif //IMTERM_LOG_EXPORT_HPP
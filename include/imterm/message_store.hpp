@@ -0,0 +1,697 @@
+#ifndef IMTERM_MESSAGE_STORE_HPP
+#define IMTERM_MESSAGE_STORE_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <array>
+#include <map>
+#include <string>
+#include <string_view>
+#include <functional>
+#include <algorithm>
+
+#include "utils.hpp"
+#include "ansi.hpp"
+
+namespace ImTerm {
+
+	// Stores the messages logged to one or more terminals.
+	// A store may be shared between several terminals (see terminal::set_message_store), each message being held only once.
+	// Every terminal is then a view over the store, with its own filter and log level.
+	//
+	// Each stored message is given a sequence number. Sequence numbers are strictly increasing and never reused (even after a clear),
+	// the messages currently stored are those whose sequence number lies in [first_seq(), end_seq()).
+	// Sequence numbers are also indexed by severity, so that filtering by log level only touches matching messages.
+	// Each stored message is also stamped with the time it was stored at. Stamps never decrease with sequence numbers,
+	// so that the messages logged in a time range can be found by binary search (see seq_at).
+	//
+	// Messages are tagged with a channel (see channel()). Messages whose channel is not part of the ingest mask are dropped by push,
+	// terminal messages excepted.
+	//
+	// If a repeat window is set, a pushed message identical to one of the last stored messages is not stored:
+	// the stored message's repeat count is incremented instead (see set_repeat_window).
+	//
+	// The store holds at most max_size() messages and, if a byte budget is set, at most max_bytes() bytes of messages (see memory()).
+	// The oldest messages are evicted to respect both limits.
+	//
+	// If ANSI parsing is enabled, escape sequences are removed from pushed messages, their colors being kept as color spans.
+	//
+	// Pushed messages then go through the ingest policy of their severity (sampling, rate limit, overload behavior, see ingest_policy).
+	// Dropped messages are reported by a synthetic "N messages dropped" warning.
+	//
+	// push, push_bulk, clear, set_max_size and lock_stats may be called from any thread.
+	// Every other method requires the store to be locked (see lock() and unlock())
+	class message_store {
+	public:
+		using size_type = std::vector<message>::size_type;
+		using seq_type = unsigned long long;
+		using seq_list = std::deque<seq_type>;
+		using view_id = unsigned int;
+
+		static constexpr view_id no_view = 0u;
+
+		// contention on the store's lock, see lock_stats
+		struct lock_statistics {
+			unsigned long long contended{0u}; // number of calls to lock() that found the store locked
+			std::chrono::nanoseconds spin_time{0}; // time spent by those calls waiting for the store to be unlocked
+		};
+
+		// memory held by the store, in bytes
+		struct memory_usage {
+			size_type text{0u}; // heap memory held by the text and color spans of the stored messages
+			size_type metadata{0u}; // message records (including the memory reserved for future messages) and indexes
+
+			size_type total() const noexcept {
+				return text + metadata;
+			}
+		};
+
+		// applied by push to the messages of a given severity, before they are stored. Terminal messages are never dropped.
+		struct ingest_policy {
+			enum class overload_behavior {
+				drop_oldest, // messages are always stored, the oldest ones being evicted when the store is full
+				drop_newest, // messages are dropped while at least max_pending messages are pending (see max_pending)
+				block,       // producers wait (at most block_timeout) while at least max_pending messages are pending, then the message
+				             // is dropped. No terminal showing the store means every producer waits for block_timeout.
+				             // Messages logged from the thread showing the terminals are dropped without waiting, as only it can relieve them
+			};
+
+			double sampling{1.}; // probability for a message to be kept
+			double rate_limit{0.}; // maximum number of messages per second (token bucket), 0 for no limit
+			double burst{100.}; // number of messages that can exceed the rate limit at once (token bucket capacity)
+
+			overload_behavior on_overload{overload_behavior::drop_oldest};
+			// number of pending messages from which the store is overloaded: messages pushed since the last frame of any terminal
+			// showing the store (see mark_consumed). Messages are no longer pending once a frame went through them, whether it displayed
+			// them or not (filtered out, outside of the time range or scrolled past)
+			size_type max_pending{1'000};
+			std::chrono::microseconds block_timeout{1'000};
+		};
+
+		explicit message_store(size_type max_size = 5'000) : m_max_size{max_size} {
+			m_flag.clear();
+			m_channel_names.emplace_back();
+		}
+
+		message_store(const message_store&) = delete;
+		message_store& operator=(const message_store&) = delete;
+
+		// returns a new identifier, used by terminals to recognize their own messages
+		// the view is counted until it is unregistered (see view_count)
+		view_id register_view() noexcept {
+			m_view_count.fetch_add(1u, std::memory_order_relaxed);
+			return ++m_last_view_id;
+		}
+
+		// a view registered with register_view stops displaying the store
+		void unregister_view() noexcept {
+			m_view_count.fetch_sub(1u, std::memory_order_relaxed);
+		}
+
+		// number of views displaying the store. Background jobs holding the store (exports, file tails, ...) are not views
+		unsigned int view_count() const noexcept {
+			return m_view_count.load(std::memory_order_relaxed);
+		}
+
+		// stores a message, evicting the oldest one if the store is full
+		// origin is the view that emitted the message. Terminal messages (message::is_term_message) are only displayed by their origin
+		void push(message&& msg, view_id origin = no_view) {
+			std::size_t identity = repeat_window() > 0 ? identity_of(msg.value) : 0u;
+			push(std::move(msg), origin, identity);
+		}
+
+		// same as above, identity being the hash of the text used to detect repeated messages (see identity_of)
+		// useful when msg.value is decorated (by a timestamp for instance), to give the identity of the undecorated text
+		void push(message&& msg, view_id origin, std::size_t identity) {
+			if (!prepare_(msg)) {
+				return;
+			}
+			lock();
+			push_(std::move(msg), origin, identity);
+			unlock();
+		}
+
+		// stores several messages at once, taking the lock only once. msgs is left in an unspecified state.
+		// identities are computed if a repeat window is set
+		void push_bulk(std::vector<message>& msgs, view_id origin = no_view) {
+			const bool compute_identities = repeat_window() > 0;
+			auto kept_end = std::remove_if(msgs.begin(), msgs.end(), [this](message& msg) {
+				return !prepare_(msg);
+			});
+			lock();
+			for (auto it = msgs.begin() ; it != kept_end ; ++it) {
+				std::size_t identity = compute_identities ? identity_of(it->value) : 0u;
+				push_(std::move(*it), origin, identity);
+			}
+			unlock();
+		}
+
+		// if one of the last repeat_window() stored messages has the given identity, severity and channel,
+		// increments its repeat count, updates its time, and returns true. Returns false otherwise. May be called from any thread.
+		// producers may use this to avoid formatting repeated messages
+		bool repeat(std::size_t identity, message::severity::severity_t severity, message::channel_id channel,
+		            std::chrono::system_clock::time_point time = std::chrono::system_clock::now()) {
+			if (repeat_window() == 0) {
+				return false;
+			}
+			lock();
+			bool repeated = repeat_(identity, severity, channel, time);
+			unlock();
+			return repeated;
+		}
+
+		// sets the number of most recent messages a pushed message is compared to, to detect repetitions. 0 disables the detection.
+		// May be called from any thread.
+		void set_repeat_window(size_type window) noexcept {
+			m_repeat_window.store(window, std::memory_order_relaxed);
+		}
+
+		size_type repeat_window() const noexcept {
+			return m_repeat_window.load(std::memory_order_relaxed);
+		}
+
+		// sets whether ANSI escape sequences are parsed (and removed) from pushed messages, see ansi::parse_sgr. May be called from any thread.
+		// parsing is done by push, in the producer's thread, or once formatted for messages whose formatting was deferred
+		void set_ansi_parsing(bool parse) noexcept {
+			m_ansi_parsing.store(parse, std::memory_order_relaxed);
+		}
+
+		bool ansi_parsing() const noexcept {
+			return m_ansi_parsing.load(std::memory_order_relaxed);
+		}
+
+		// identity of a message text, used to detect repeated messages
+		static std::size_t identity_of(std::string_view text) noexcept {
+			return std::hash<std::string_view>{}(text);
+		}
+
+		// sets the ingest policy for messages of the given severity. May be called from any thread.
+		void set_ingest_policy(message::severity::severity_t severity, const ingest_policy& policy) {
+			lock();
+			m_policies[severity] = policy;
+			m_buckets[severity] = {policy.burst, std::chrono::steady_clock::now()};
+			unlock();
+		}
+
+		ingest_policy get_ingest_policy(message::severity::severity_t severity) {
+			lock();
+			ingest_policy policy = m_policies[severity];
+			unlock();
+			return policy;
+		}
+
+		// number of messages of the given severity dropped by the ingest policies since the creation of the store
+		unsigned long long dropped_count(message::severity::severity_t severity) const noexcept {
+			return m_dropped[severity].load(std::memory_order_relaxed);
+		}
+
+		// stores a "N messages dropped" warning if messages were dropped since the last report
+		void report_drops() {
+			if (m_unreported_drops == 0u) {
+				return;
+			}
+			std::string text = std::to_string(m_unreported_drops) + " messages dropped";
+			message notice{message::severity::warn, std::move(text), 0u, 0u, false};
+			notice.color_end = notice.value.size();
+			notice.time = notice.first_time = std::chrono::system_clock::now();
+			m_unreported_drops = 0u;
+			store_(std::move(notice), no_view, 0u);
+		}
+
+		// called by terminals at each frame, with the end of the store: messages before seq are no longer pending (see
+		// ingest_policy::max_pending), which relieves overloaded producers. The calling thread is the one showing the terminals
+		void mark_consumed(seq_type seq) {
+			m_consuming_thread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+			if (seq > m_consumed_seq.load(std::memory_order_relaxed)) {
+				m_consumed_seq.store(seq, std::memory_order_relaxed);
+				if (m_blocked_producers.load(std::memory_order_relaxed) > 0) {
+					std::lock_guard<std::mutex> guard{m_overload_mutex};
+					m_overload_cv.notify_all();
+				}
+			}
+		}
+
+		// removes every message from the store
+		void clear() {
+			lock();
+			m_records.clear();
+			m_oldest_idx = 0u;
+			m_first_seq = m_end_seq;
+			m_text_bytes = 0u;
+			for (seq_list& list : m_by_severity) {
+				list.clear();
+			}
+			m_term_messages.clear();
+			++m_generation;
+			unlock();
+		}
+
+		// sets the maximum number of stored messages. O(number of evicted messages): the buffer is not reallocated.
+		// growing only raises the limit, records being allocated as messages come. Shrinking evicts the oldest messages,
+		// the memory of their records being reused by the next messages (see memory())
+		void set_max_size(size_type max_size) {
+			lock();
+			m_max_size = max_size;
+			while (size() > max_size) {
+				evict_oldest_();
+			}
+			unlock();
+		}
+
+		size_type max_size() const noexcept {
+			return m_max_size;
+		}
+
+		// sets the maximum number of bytes held by the stored messages (see memory_usage::text), 0 for no limit (default).
+		// Each stored message also accounts for the size of its record. The last stored message is kept even if it exceeds the budget.
+		// May be called from any thread.
+		void set_max_bytes(size_type max_bytes) {
+			lock();
+			m_max_bytes = max_bytes;
+			enforce_byte_budget_();
+			unlock();
+		}
+
+		size_type max_bytes() const noexcept {
+			return m_max_bytes;
+		}
+
+		// number of stored messages
+		size_type size() const noexcept {
+			return static_cast<size_type>(m_end_seq - m_first_seq);
+		}
+
+		// memory currently held by the store
+		memory_usage memory() const noexcept {
+			memory_usage usage;
+			usage.text = m_text_bytes;
+			usage.metadata = m_records.capacity() * sizeof(record) + m_term_messages.size() * sizeof(seq_type);
+			for (const seq_list& list : m_by_severity) {
+				usage.metadata += list.size() * sizeof(seq_type);
+			}
+			return usage;
+		}
+
+		// returns the channel id associated to the given name, registering it if needed. May be called from any thread.
+		// the empty name is message::default_channel
+		// at most message::max_channels channels may be registered, channels registered afterward share the last id
+		message::channel_id channel(std::string_view name) {
+			lock();
+			auto it = m_channel_ids.find(name);
+			message::channel_id id;
+			if (it != m_channel_ids.end()) {
+				id = it->second;
+			} else if (name.empty()) {
+				id = message::default_channel;
+			} else {
+				id = static_cast<message::channel_id>(std::min<size_type>(m_channel_names.size(), message::max_channels - 1));
+				if (m_channel_names.size() < message::max_channels) {
+					m_channel_names.emplace_back(name);
+				}
+				m_channel_ids.emplace(name, id);
+			}
+			unlock();
+			return id;
+		}
+
+		// returns the name of the given channel. May be called from any thread.
+		std::string channel_name(message::channel_id id) {
+			lock();
+			std::string name = id < m_channel_names.size() ? m_channel_names[id] : std::string{};
+			unlock();
+			return name;
+		}
+
+		// sets the channels for which messages are stored. Messages from other channels are discarded before being stored.
+		// May be called from any thread.
+		void set_ingest_mask(message::channel_mask mask) noexcept {
+			m_ingest_mask.store(mask, std::memory_order_relaxed);
+		}
+
+		message::channel_mask ingest_mask() const noexcept {
+			return m_ingest_mask.load(std::memory_order_relaxed);
+		}
+
+		// returns true if messages from the given channel are stored. May be called from any thread.
+		bool accepts(message::channel_id id) const noexcept {
+			return (ingest_mask() >> id) & 1u;
+		}
+
+		// changes whenever a message is stored, repeated or removed. Terminals compare it to skip work on frames where nothing changed
+		seq_type generation() const noexcept {
+			return m_generation;
+		}
+
+		// sequence number of the first stored message stamped at or after time, end_seq() if there is none. O(log(n))
+		seq_type seq_at(std::chrono::system_clock::time_point time) const noexcept {
+			seq_type beg = m_first_seq;
+			seq_type end = m_end_seq;
+			while (beg < end) {
+				const seq_type mid = beg + (end - beg) / 2;
+				if (get(mid).stamp < time) {
+					beg = mid + 1;
+				} else {
+					end = mid;
+				}
+			}
+			return beg;
+		}
+
+		// seq must be in [first_seq(), end_seq())
+		// time at which the message was stored: the time of its first occurrence, raised if needed to keep stamps in order
+		std::chrono::system_clock::time_point stamp(seq_type seq) const noexcept {
+			return get(seq).stamp;
+		}
+
+		// sequence number of the oldest stored message
+		seq_type first_seq() const noexcept {
+			return m_first_seq;
+		}
+
+		// sequence number the next pushed message will get
+		seq_type end_seq() const noexcept {
+			return m_end_seq;
+		}
+
+		// seq must be in [first_seq(), end_seq())
+		const message& at(seq_type seq) const noexcept {
+			return get(seq).msg;
+		}
+
+		// seq must be in [first_seq(), end_seq())
+		// formats the message if its formatting was deferred (see message::formatter), and returns it
+		const message& formatted(seq_type seq) {
+			record& rec = get(seq);
+			message& msg = rec.msg;
+			if (msg.formatter) {
+				std::shared_ptr<message_formatter> formatter = std::move(msg.formatter);
+				msg.formatter.reset();
+				formatter->format(msg, msg.channel < m_channel_names.size() ? m_channel_names[msg.channel] : std::string_view{});
+				if (ansi_parsing()) {
+					ansi::parse_sgr(msg);
+				}
+				m_text_bytes -= rec.bytes;
+				rec.bytes = bytes_of(msg);
+				m_text_bytes += rec.bytes;
+			}
+			return msg;
+		}
+
+		// seq must be in [first_seq(), end_seq())
+		view_id origin(seq_type seq) const noexcept {
+			return get(seq).origin;
+		}
+
+		// sorted sequence numbers of the stored messages of the given severity, terminal messages excluded
+		const seq_list& messages_of(message::severity::severity_t severity) const noexcept {
+			return m_by_severity[severity];
+		}
+
+		// sorted sequence numbers of the stored terminal messages (message::is_term_message), whatever their origin
+		const seq_list& term_messages() const noexcept {
+			return m_term_messages;
+		}
+
+		inline void lock() noexcept {
+			if (!m_flag.test_and_set(std::memory_order_seq_cst)) {
+				return;
+			}
+			// contended: only then is the clock read
+			const auto spin_beg = std::chrono::steady_clock::now();
+			while (m_flag.test_and_set(std::memory_order_seq_cst)) {}
+			m_contended_locks.fetch_add(1u, std::memory_order_relaxed);
+			m_spin_ns.fetch_add(static_cast<unsigned long long>((std::chrono::steady_clock::now() - spin_beg).count()), std::memory_order_relaxed);
+		}
+
+		inline void unlock() noexcept {
+			m_flag.clear(std::memory_order_seq_cst);
+		}
+
+		// contention on the lock since the creation of the store, or the last call to reset_lock_stats
+		lock_statistics lock_stats() const noexcept {
+			lock_statistics stats;
+			stats.contended = m_contended_locks.load(std::memory_order_relaxed);
+			stats.spin_time = std::chrono::nanoseconds{static_cast<std::chrono::nanoseconds::rep>(m_spin_ns.load(std::memory_order_relaxed))};
+			return stats;
+		}
+
+		void reset_lock_stats() noexcept {
+			m_contended_locks.store(0u, std::memory_order_relaxed);
+			m_spin_ns.store(0u, std::memory_order_relaxed);
+		}
+
+	private:
+		struct record {
+			message msg;
+			view_id origin;
+			std::size_t identity;
+			std::chrono::system_clock::time_point stamp; // never lower than the stamp of the previous record, see seq_at
+			size_type bytes; // heap memory held by msg, see bytes_of
+		};
+
+		// heap memory held by a message's text and color spans
+		static size_type bytes_of(const message& msg) noexcept {
+			const size_type text = msg.value.capacity() > std::string{}.capacity() ? msg.value.capacity() + 1 : 0u; // short strings are not allocated
+			return text + msg.color_spans.capacity() * sizeof(message::color_span);
+		}
+
+		// done before locking the store. Returns false if the message is not to be stored
+		bool prepare_(message& msg) {
+			if (!msg.is_term_message && !accepts(msg.channel)) {
+				return false;
+			}
+			if (ansi_parsing() && !msg.formatter) {
+				ansi::parse_sgr(msg);
+			}
+			if (msg.time == std::chrono::system_clock::time_point{}) {
+				msg.time = std::chrono::system_clock::now();
+			}
+			msg.first_time = msg.time;
+			return true;
+		}
+
+		// store must be locked
+		void push_(message&& msg, view_id origin, std::size_t identity) {
+			if (!msg.is_term_message) {
+				if (repeat_(identity, msg.severity, msg.channel, msg.time)) {
+					return;
+				}
+				if (!admit_(msg.severity)) {
+					m_dropped[msg.severity].fetch_add(1u, std::memory_order_relaxed);
+					++m_unreported_drops;
+					return;
+				}
+			}
+			report_drops();
+			store_(std::move(msg), origin, identity);
+		}
+
+		// store must be locked
+		void store_(message&& msg, view_id origin, std::size_t identity) {
+			++m_generation;
+			m_last_stamp = std::max(m_last_stamp, msg.first_time);
+			if (m_max_size == 0u) {
+				++m_first_seq;
+				++m_end_seq;
+				return;
+			}
+			if (size() == m_max_size) {
+				evict_oldest_();
+			}
+
+			const size_type bytes = bytes_of(msg);
+			index_of(msg).push_back(m_end_seq);
+			record rec{std::move(msg), origin, identity, m_last_stamp, bytes};
+			if (size() == m_records.size()) {
+				// every record is in use: growing the buffer, oldest record first
+				std::rotate(m_records.begin(), m_records.begin() + static_cast<std::ptrdiff_t>(m_oldest_idx), m_records.end());
+				m_oldest_idx = 0u;
+				m_records.push_back(std::move(rec));
+			} else {
+				m_records[(m_oldest_idx + size()) % m_records.size()] = std::move(rec);
+			}
+			m_text_bytes += bytes;
+			++m_end_seq;
+
+			enforce_byte_budget_();
+		}
+
+		// store must be locked, and contain at least one message
+		void evict_oldest_() {
+			record& oldest = m_records[m_oldest_idx];
+			index_of(oldest.msg).pop_front();
+			m_text_bytes -= oldest.bytes;
+			{
+				record released{std::move(oldest)}; // releasing its memory, the record may not be reused right away
+			}
+			m_oldest_idx = (m_oldest_idx + 1) % m_records.size();
+			++m_first_seq;
+			++m_generation;
+		}
+
+		// store must be locked
+		void enforce_byte_budget_() {
+			if (m_max_bytes == 0u) {
+				return;
+			}
+			while (size() > 1u && m_text_bytes + size() * sizeof(record) > m_max_bytes) {
+				evict_oldest_();
+			}
+		}
+
+		// applies the ingest policy of the given severity, returns false if the message should be dropped
+		// store must be locked, and might be unlocked in between if producers are to be blocked
+		bool admit_(message::severity::severity_t severity) {
+			const ingest_policy& policy = m_policies[severity];
+
+			if (policy.sampling < 1.) {
+				// xorshift64
+				m_random_state ^= m_random_state << 13u;
+				m_random_state ^= m_random_state >> 7u;
+				m_random_state ^= m_random_state << 17u;
+				if (static_cast<double>(m_random_state >> 11u) * 0x1.0p-53 >= policy.sampling) {
+					return false;
+				}
+			}
+
+			if (policy.rate_limit > 0.) {
+				token_bucket& bucket = m_buckets[severity];
+				auto now = std::chrono::steady_clock::now();
+				std::chrono::duration<double> elapsed = now - bucket.last_refill;
+				bucket.tokens = std::min(policy.burst, bucket.tokens + elapsed.count() * policy.rate_limit);
+				bucket.last_refill = now;
+				if (bucket.tokens < 1.) {
+					return false;
+				}
+				bucket.tokens -= 1.;
+			}
+
+			const size_type max_pending = policy.max_pending;
+			auto overloaded = [this, max_pending]() {
+				return m_end_seq - m_consumed_seq.load(std::memory_order_relaxed) >= max_pending;
+			};
+			switch (policy.on_overload) {
+				case ingest_policy::overload_behavior::drop_oldest:
+					return true;
+				case ingest_policy::overload_behavior::drop_newest:
+					return !overloaded();
+				case ingest_policy::overload_behavior::block:
+					if (overloaded()) {
+						if (std::this_thread::get_id() == m_consuming_thread.load(std::memory_order_relaxed)) {
+							return false; // waiting would only delay the frame relieving the store
+						}
+						const auto deadline = std::chrono::steady_clock::now() + policy.block_timeout;
+						const seq_type awaited_seq = m_end_seq - max_pending + 1;
+						++m_blocked_producers;
+						unlock();
+						{
+							// store's lock must not be taken here, as mark_consumed takes m_overload_mutex with the store locked
+							std::unique_lock<std::mutex> guard{m_overload_mutex};
+							m_overload_cv.wait_until(guard, deadline, [&]() {
+								return m_consumed_seq.load(std::memory_order_relaxed) >= awaited_seq;
+							});
+						}
+						lock();
+						--m_blocked_producers;
+						return !overloaded();
+					}
+					return true;
+			}
+			return true;
+		}
+
+		bool repeat_(std::size_t identity, message::severity::severity_t severity, message::channel_id channel,
+		             std::chrono::system_clock::time_point time) noexcept {
+			const size_type window = std::min(repeat_window(), size());
+			for (seq_type seq = m_end_seq ; seq != m_end_seq - window ; --seq) {
+				record& rec = get(seq - 1);
+				if (!rec.msg.is_term_message && rec.identity == identity && rec.msg.severity == severity && rec.msg.channel == channel) {
+					++rec.msg.repeat_count;
+					++m_generation;
+					rec.msg.time = time;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		seq_list& index_of(const message& msg) noexcept {
+			return msg.is_term_message ? m_term_messages : m_by_severity[msg.severity];
+		}
+
+		const record& get(seq_type seq) const noexcept {
+			assert(seq >= m_first_seq && seq < m_end_seq);
+			return m_records[(m_oldest_idx + static_cast<size_type>(seq - m_first_seq)) % m_records.size()];
+		}
+
+		record& get(seq_type seq) noexcept {
+			return const_cast<record&>(static_cast<const message_store&>(*this).get(seq));
+		}
+
+		std::vector<record> m_records{};
+		size_type m_max_size;
+		size_type m_oldest_idx{0u}; // index of the record of first_seq(). Records are used as a ring buffer
+		size_type m_max_bytes{0u};
+		size_type m_text_bytes{0u}; // sum of the records' bytes
+
+		seq_type m_first_seq{0u};
+		seq_type m_end_seq{0u};
+		seq_type m_generation{0u};
+		std::chrono::system_clock::time_point m_last_stamp{}; // stamp of the last stored message
+
+		std::array<seq_list, message::severity::critical + 1> m_by_severity{};
+		seq_list m_term_messages{};
+
+		std::vector<std::string> m_channel_names{};
+		std::map<std::string, message::channel_id, std::less<>> m_channel_ids{};
+		std::atomic<message::channel_mask> m_ingest_mask{~message::channel_mask{0u}};
+		std::atomic<size_type> m_repeat_window{0u};
+		std::atomic<bool> m_ansi_parsing{false};
+
+		struct token_bucket {
+			double tokens;
+			std::chrono::steady_clock::time_point last_refill;
+		};
+		std::array<ingest_policy, message::severity::critical + 1> m_policies{};
+		std::array<token_bucket, message::severity::critical + 1> m_buckets{};
+		std::array<std::atomic<unsigned long long>, message::severity::critical + 1> m_dropped{}; // written with the store locked
+		unsigned long long m_unreported_drops{0u};
+		std::uint64_t m_random_state{0x9E3779B97F4A7C15u};
+
+		std::atomic<seq_type> m_consumed_seq{0u};
+		std::atomic<std::thread::id> m_consuming_thread{}; // last thread that called mark_consumed
+		std::atomic<unsigned int> m_blocked_producers{0u};
+		std::mutex m_overload_mutex{};
+		std::condition_variable m_overload_cv{};
+
+		std::atomic<view_id> m_last_view_id{no_view};
+		std::atomic<unsigned int> m_view_count{0u};
+		std::atomic_flag m_flag;
+		std::atomic<unsigned long long> m_contended_locks{0u};
+		std::atomic<unsigned long long> m_spin_ns{0u};
+	};
+}
+
+#endif //IMTERM_MESSAGE_STORE_HPP
@@ -173,6 +173,11 @@ namespace misc {
 		return ec == std::errc{};
 	}
 
+	// true if a and b are more than tolerance apart
+	constexpr bool differs(float a, float b, float tolerance) {
+		return a - b > tolerance || b - a > tolerance;
+	}
+
 	// Search any element starting by "prefix" in the sorted collection formed by [c_beg, c_end)
 	// str_ext must map dectype(*c_beg) to std::string_view
 	// transform is whatever transformation you want to do to the matching elements.
@@ -0,0 +1,390 @@
+#ifndef IMTERM_SESSION_RECORD_HPP
+#define IMTERM_SESSION_RECORD_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "utils.hpp"
+
+// Recording of what a terminal goes through (messages added, command line and filter edits, executed commands, frames) to a
+// compact binary file, and replay of that file into another terminal, to turn a recorded session into a repeatable benchmark.
+//
+// File format: "IMTERMREC" followed by a version byte, then one record per event:
+//     kind (1 byte), microseconds elapsed since the previous event (varint), payload
+// Payloads:
+//     message:      severity (1 byte), flags (1 byte: 1 = terminal message, 2 = has identity), channel (1 byte),
+//                   identity (varint, if flagged), color_beg (varint), color_end (varint), text
+//     command_line: text (the whole command line after the edit)
+//     filter:       text (the whole filter after the edit)
+//     execute:      text (the executed command line)
+//     frame:        nothing (beginning of a call to terminal::show)
+// Texts are stored as their size (varint) followed by their bytes. Varints are little endian base 128.
+namespace ImTerm {
+
+	namespace details::session {
+		constexpr std::string_view magic{"IMTERMREC"};
+		constexpr std::uint8_t version = 1u;
+
+		enum class event_kind : std::uint8_t {
+			message = 0,
+			command_line = 1,
+			filter = 2,
+			execute = 3,
+			frame = 4,
+		};
+
+		enum message_flags : std::uint8_t {
+			term_message = 1u,
+			has_identity = 2u,
+		};
+
+		inline void put_varint(std::string& out, std::uint64_t value) {
+			while (value >= 0x80u) {
+				out += static_cast<char>((value & 0x7Fu) | 0x80u);
+				value >>= 7u;
+			}
+			out += static_cast<char>(value);
+		}
+
+		inline void put_text(std::string& out, std::string_view text) {
+			put_varint(out, text.size());
+			out.append(text);
+		}
+
+		// reads from [it, end). Returns false if the data is truncated or malformed
+		inline bool get_varint(const char*& it, const char* end, std::uint64_t& value) {
+			value = 0u;
+			for (unsigned int shift = 0u ; it != end && shift < 64u ; shift += 7u) {
+				const auto byte = static_cast<std::uint8_t>(*it++);
+				value |= static_cast<std::uint64_t>(byte & 0x7Fu) << shift;
+				if ((byte & 0x80u) == 0u) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		inline bool get_text(const char*& it, const char* end, std::string& text) {
+			std::uint64_t size;
+			if (!get_varint(it, end, size) || size > static_cast<std::uint64_t>(end - it)) {
+				return false;
+			}
+			text.assign(it, static_cast<std::size_t>(size));
+			it += size;
+			return true;
+		}
+	}
+
+	// Records the events of a terminal to a file (see terminal::record_session). Events are buffered, and written by blocks.
+	// Messages may be added from any thread. Messages formatted at display time (message::formatter) are recorded unformatted
+	class session_recorder {
+	public:
+		explicit session_recorder(std::string path)
+			: m_file{path, std::ios::out | std::ios::trunc | std::ios::binary}
+			, m_path{std::move(path)}
+			, m_last_event{std::chrono::steady_clock::now()} {
+			m_buffer.append(details::session::magic);
+			m_buffer += static_cast<char>(details::session::version);
+		}
+
+		session_recorder(const session_recorder&) = delete;
+		session_recorder& operator=(const session_recorder&) = delete;
+
+		~session_recorder() {
+			flush();
+		}
+
+		// false if the file could not be opened or written to
+		bool good() const {
+			return static_cast<bool>(m_file);
+		}
+
+		const std::string& path() const noexcept {
+			return m_path;
+		}
+
+		void record_message(const message& msg, std::optional<std::size_t> identity = {}) {
+			std::lock_guard<std::mutex> guard{m_mutex};
+			begin_event_(details::session::event_kind::message);
+			std::uint8_t flags = 0u;
+			if (msg.is_term_message) {
+				flags |= details::session::term_message;
+			}
+			if (identity) {
+				flags |= details::session::has_identity;
+			}
+			m_buffer += static_cast<char>(msg.severity);
+			m_buffer += static_cast<char>(flags);
+			m_buffer += static_cast<char>(msg.channel);
+			if (identity) {
+				details::session::put_varint(m_buffer, *identity);
+			}
+			details::session::put_varint(m_buffer, msg.color_beg);
+			details::session::put_varint(m_buffer, msg.color_end);
+			details::session::put_text(m_buffer, msg.value);
+			end_event_();
+		}
+
+		void record_command_line(std::string_view text) {
+			record_text_(details::session::event_kind::command_line, text);
+		}
+
+		void record_filter(std::string_view text) {
+			record_text_(details::session::event_kind::filter, text);
+		}
+
+		void record_execute(std::string_view text) {
+			record_text_(details::session::event_kind::execute, text);
+		}
+
+		void record_frame() {
+			std::lock_guard<std::mutex> guard{m_mutex};
+			begin_event_(details::session::event_kind::frame);
+			end_event_();
+		}
+
+		// writes the buffered events to the file
+		void flush() {
+			std::lock_guard<std::mutex> guard{m_mutex};
+			flush_();
+			m_file.flush();
+		}
+
+	private:
+		static constexpr std::size_t block_size = 64u << 10u;
+
+		void record_text_(details::session::event_kind kind, std::string_view text) {
+			std::lock_guard<std::mutex> guard{m_mutex};
+			begin_event_(kind);
+			details::session::put_text(m_buffer, text);
+			end_event_();
+		}
+
+		// m_mutex must be held
+		void begin_event_(details::session::event_kind kind) {
+			const auto now = std::chrono::steady_clock::now();
+			const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - m_last_event).count();
+			m_last_event = now;
+			m_buffer += static_cast<char>(kind);
+			details::session::put_varint(m_buffer, static_cast<std::uint64_t>(elapsed));
+		}
+
+		// m_mutex must be held
+		void end_event_() {
+			if (m_buffer.size() >= block_size) {
+				flush_();
+			}
+		}
+
+		// m_mutex must be held
+		void flush_() {
+			m_file.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+			m_buffer.clear();
+		}
+
+		std::mutex m_mutex{};
+		std::ofstream m_file;
+		std::string m_path;
+		std::string m_buffer{};
+		std::chrono::steady_clock::time_point m_last_event;
+	};
+
+	// Replays a file written by session_recorder into a terminal
+	class session_replay {
+	public:
+		enum class pacing {
+			original,       // events are replayed at the time they were recorded at, relatively to the beginning of the replay
+			fast,           // as fast as possible
+		};
+
+		// time spent in a recorded frame
+		struct frame_timing {
+			std::size_t events;                  // number of events replayed since the previous frame
+			std::chrono::nanoseconds apply;      // time spent replaying them (adding messages, executing commands, ...)
+			std::chrono::nanoseconds frame;      // time spent in the frame function
+		};
+
+		// loads the events of the file at path. Returns false if the file cannot be read or is not a valid recording;
+		// the events read before a truncated or malformed one are kept
+		bool load(const std::string& path) {
+			m_events.clear();
+			std::ifstream file{path, std::ios::in | std::ios::binary};
+			if (!file) {
+				return false;
+			}
+			const std::string data{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+
+			const std::string_view header = std::string_view{data}.substr(0, details::session::magic.size() + 1);
+			if (header.size() != details::session::magic.size() + 1 || header.substr(0, details::session::magic.size()) != details::session::magic
+			    || static_cast<std::uint8_t>(header.back()) != details::session::version) {
+				return false;
+			}
+
+			const char* it = data.data() + header.size();
+			const char* const end = data.data() + data.size();
+			std::chrono::microseconds time{0};
+			while (it != end) {
+				event ev{};
+				ev.kind = static_cast<details::session::event_kind>(*it++);
+				std::uint64_t elapsed;
+				if (!details::session::get_varint(it, end, elapsed)) {
+					return false;
+				}
+				time += std::chrono::microseconds{static_cast<std::chrono::microseconds::rep>(elapsed)};
+				ev.time = time;
+
+				bool valid = true;
+				switch (ev.kind) {
+					case details::session::event_kind::message:
+						valid = read_message_(it, end, ev);
+						break;
+					case details::session::event_kind::command_line:
+					case details::session::event_kind::filter:
+					case details::session::event_kind::execute:
+						valid = details::session::get_text(it, end, ev.text);
+						break;
+					case details::session::event_kind::frame:
+						break;
+					default:
+						valid = false;
+				}
+				if (!valid) {
+					return false;
+				}
+				m_events.push_back(std::move(ev));
+			}
+			return true;
+		}
+
+		std::size_t event_count() const noexcept {
+			return m_events.size();
+		}
+
+		// replays the loaded events into term, calling frame where terminal::show was called during the recording
+		// frame would typically start an ImGui frame and show the terminal, ie:
+		//     [&term]() { ImGui::NewFrame(); term.show(); ImGui::Render(); }
+		// returns the timing of each frame
+		template <typename Terminal>
+		std::vector<frame_timing> run(Terminal& term, pacing pace, const std::function<void()>& frame) const {
+			using clock = std::chrono::steady_clock;
+
+			std::vector<frame_timing> timings;
+			frame_timing current{0u, {}, {}};
+			const clock::time_point start = clock::now();
+			for (const event& ev : m_events) {
+				if (pace == pacing::original) {
+					std::this_thread::sleep_until(start + ev.time);
+				}
+
+				const clock::time_point beg = clock::now();
+				switch (ev.kind) {
+					case details::session::event_kind::message: {
+						message msg{ev.severity, ev.text, ev.color_beg, ev.color_end, ev.is_term_message};
+						msg.channel = ev.channel;
+						if (ev.identity) {
+							term.add_message(std::move(msg), *ev.identity);
+						} else {
+							term.add_message(std::move(msg));
+						}
+						break;
+					}
+					case details::session::event_kind::command_line:
+						term.set_command_line(ev.text);
+						break;
+					case details::session::event_kind::filter:
+						term.set_filter(ev.text);
+						break;
+					case details::session::event_kind::execute:
+						term.execute(ev.text);
+						break;
+					case details::session::event_kind::frame: {
+						if (frame) {
+							frame();
+						}
+						current.frame = clock::now() - beg;
+						timings.push_back(current);
+						current = {0u, {}, {}};
+						continue;
+					}
+				}
+				current.apply += clock::now() - beg;
+				++current.events;
+			}
+			return timings;
+		}
+
+	private:
+		struct event {
+			details::session::event_kind kind;
+			std::chrono::microseconds time; // since the beginning of the recording
+			std::string text;
+			message::severity::severity_t severity;
+			bool is_term_message;
+			message::channel_id channel;
+			std::optional<std::size_t> identity;
+			std::size_t color_beg;
+			std::size_t color_end;
+		};
+
+		static bool read_message_(const char*& it, const char* end, event& ev) {
+			if (end - it < 3) {
+				return false;
+			}
+			const auto severity = static_cast<std::uint8_t>(*it++);
+			const auto flags = static_cast<std::uint8_t>(*it++);
+			ev.channel = static_cast<message::channel_id>(*it++);
+			if (severity > message::severity::critical) {
+				return false;
+			}
+			ev.severity = static_cast<message::severity::severity_t>(severity);
+			ev.is_term_message = (flags & details::session::term_message) != 0u;
+
+			std::uint64_t value;
+			if ((flags & details::session::has_identity) != 0u) {
+				if (!details::session::get_varint(it, end, value)) {
+					return false;
+				}
+				ev.identity = static_cast<std::size_t>(value);
+			}
+			if (!details::session::get_varint(it, end, value)) {
+				return false;
+			}
+			ev.color_beg = static_cast<std::size_t>(value);
+			if (!details::session::get_varint(it, end, value)) {
+				return false;
+			}
+			ev.color_end = static_cast<std::size_t>(value);
+			return details::session::get_text(it, end, ev.text);
+		}
+
+		std::vector<event> m_events{};
+	};
+}
+
+#endif //IMTERM_SESSION_RECORD_HPP
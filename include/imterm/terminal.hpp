@@ -18,21 +18,36 @@
 ///                                                                                                                                     ///
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-#include <atomic>
 #include <vector>
+#include <deque>
+#include <map>
+#include <set>
 #include <string>
 #include <utility>
 #include <optional>
+#include <memory>
 #include <array>
+#include <atomic>
 #include <imgui.h>
 
 #include "utils.hpp"
 #include "misc.hpp"
+#include "message_store.hpp"
+#include "log_export.hpp"
+#include "file_tail.hpp"
+#include "file_writer.hpp"
+#include "session_record.hpp"
+#include "latency_histogram.hpp"
 
 #ifdef IMTERM_USE_FMT
+#include <tuple>
 #include "fmt/format.h"
 #endif
 
+#ifdef IMTERM_ENABLE_REGEX
+#include <regex>
+#endif
+
 namespace ImTerm {
 
 	// checking that you can use a given class as a TerminalHelper
@@ -73,6 +88,28 @@ namespace ImTerm {
 					"TerminalHelper should implement the method 'std::optional<term::message> format(std::string, term::message::type)'. "
 					"See term::terminal_helper_example for reference");
 		};
+
+#ifdef IMTERM_USE_FMT
+		// formats fmt with args when the message is first displayed, see terminal::add_formatted_deferred
+		template <typename... Args>
+		class deferred_format : public message_formatter {
+		public:
+			template <typename... FwdArgs>
+			explicit deferred_format(const char* fmt, FwdArgs&&... args) : m_fmt{fmt}, m_args{std::forward<FwdArgs>(args)...} {}
+
+			void format(message& msg, std::string_view) override {
+				try {
+					msg.value = std::apply([this](const Args&... args) { return fmt::format(m_fmt, args...); }, m_args);
+				} catch (const fmt::format_error& e) {
+					msg.value = e.what();
+				}
+			}
+
+		private:
+			const char* m_fmt;
+			std::tuple<Args...> m_args;
+		};
+#endif
 	}
 
 	template<typename TerminalHelper>
@@ -103,11 +140,39 @@ namespace ImTerm {
 		                  int base_height_ = 200, std::shared_ptr<TerminalHelper> th = std::make_shared<TerminalHelper>())
 		                  : terminal(misc::details::no_value, window_name_, base_width_, base_height_, std::move(th), terminal_helper_is_valid{}) {}
 
+		terminal(const terminal&) = delete;
+		terminal& operator=(const terminal&) = delete;
+
+		~terminal() {
+			m_store->unregister_view();
+		}
+
 		// Returns the underlying terminal helper
 		std::shared_ptr<TerminalHelper> get_terminal_helper() {
 			return m_t_helper;
 		}
 
+		// Returns the store holding the messages displayed by this terminal
+		std::shared_ptr<message_store> get_message_store() {
+			return m_store;
+		}
+
+		// Same as get_message_store, without sharing its ownership
+		message_store& message_store_ref() noexcept {
+			return *m_store;
+		}
+
+		// Returns the view this terminal registered in its message store: origin of the terminal messages it emits
+		// changes when the message store is changed
+		message_store::view_id get_view_id() const noexcept {
+			return m_view_id;
+		}
+
+		// Makes this terminal display the messages of the given store
+		// Several terminals may share the same store: each message is stored once, and every terminal keeps its own filter and log level.
+		// Terminal messages (feedback from the command line, add_text, ...) are only displayed by the terminal that emitted them.
+		void set_message_store(std::shared_ptr<message_store> store);
+
 		// shows the terminal. Call at each frame (in a more ImGui style, this would be something like ImGui::terminal(....);
 		// returns true if the terminal thinks it should still be displayed next frame, false if it thinks it should be hidden
 		// return value is true except if a command required a close, or if the "escape" key was pressed.
@@ -155,10 +220,25 @@ namespace ImTerm {
 		void add_formatted_err(const char* fmt, Args&&... args) {
 			add_text_err(fmt::format(fmt, std::forward<Args>(args)...));
 		}
+
+		// same as add_formatted, but formatting only occurs when the message is displayed, filtered or exported for the first time
+		// args are copied, fmt should have a static storage duration
+		template <typename... Args>
+		void add_formatted_deferred(const char* fmt, Args&&... args) {
+			if (m_pipe_output != nullptr) {
+				capture_output(fmt::format(fmt, std::forward<Args>(args)...));
+				return;
+			}
+			message msg{message::severity::info, {}, 0u, 0u, true};
+			msg.formatter = std::make_shared<details::deferred_format<std::decay_t<Args>...>>(fmt, std::forward<Args>(args)...);
+			msg.time = std::chrono::system_clock::now();
+			push_message(std::move(msg));
+		}
 #endif
 
 		// logs a text to the message panel
 		// added as terminal message with info severity
+		// when called by a command whose output is piped to another one, the text is given to the next command instead (colors are dropped)
 		void add_text(std::string str, unsigned int color_beg, unsigned int color_end);
 
 		// logs a text to the message panel, color spans from color_beg to the end of the message
@@ -195,7 +275,135 @@ namespace ImTerm {
 		}
 		void add_message(message&& msg);
 
+		// logs a message to the message panel, identity being used to detect repeated messages (see message_store::push)
+		void add_message(message&& msg, std::size_t identity);
+
+		// if the message identified by identity was logged recently, counts it as repeated and returns true
+		// otherwise, returns false and the message should be logged normally (see message_store::repeat)
+		bool add_repeat(std::size_t identity, message::severity::severity_t severity, message::channel_id channel,
+		                std::chrono::system_clock::time_point time = std::chrono::system_clock::now()) {
+			return m_store->repeat(identity, severity, channel, time);
+		}
+
+		// sets the number of recent messages a new message is compared to. Identical messages are collapsed into one entry,
+		// displayed with a repeat counter. 0 disables repeated messages collapsing (default)
+		// applies to every terminal sharing the message store
+		void set_repeat_window(message_store::size_type window) noexcept {
+			m_store->set_repeat_window(window);
+		}
+
+		message_store::size_type repeat_window() const noexcept {
+			return m_store->repeat_window();
+		}
+
+		// writes messages to the file at path, from a background thread (see log_export)
+		// if filtered is set to true, only the messages matching the current filter, log level and channel mask are written
+		// the returned object can be used to follow or cancel the export. The terminal keeps it alive until it is done,
+		// then displays its summary (see log_export::summary) as terminal output at the next call to show
+		std::shared_ptr<log_export> export_messages(std::string path, log_export::format fmt = log_export::format::plain, bool filtered = true);
+
+		// follows the file at path, pushing its new lines to the message store at the beginning of each call to show (see file_tail)
+		// the terminal only keeps a weak reference: the file stops being followed when the returned object is destroyed
+		std::shared_ptr<file_tail> tail_file(std::string path, file_tail::options opts = {});
+
+		// returns the output of the commands redirected to @name ("command > @name" replaces it, "command >> @name" appends to it),
+		// nullptr if nothing was redirected to @name. Output buffers are not part of the message store and are never evicted
+		const std::vector<std::string>* get_output_buffer(std::string_view name) const {
+			auto it = m_output_buffers.find(name);
+			return it == m_output_buffers.end() ? nullptr : &it->second;
+		}
+
+		// returns the names of the output buffers, sorted
+		std::vector<std::string_view> list_output_buffers() const {
+			std::vector<std::string_view> names;
+			names.reserve(m_output_buffers.size());
+			for (const auto& buffer : m_output_buffers) {
+				names.emplace_back(buffer.first);
+			}
+			return names;
+		}
+
+		// returns false if there is no output buffer of that name
+		bool erase_output_buffer(std::string_view name) {
+			auto it = m_output_buffers.find(name);
+			if (it == m_output_buffers.end()) {
+				return false;
+			}
+			m_output_buffers.erase(it);
+			return true;
+		}
+
+		// sets whether ANSI color escape sequences in incoming messages are turned into colors (see ansi::parse_sgr)
+		// applies to every terminal sharing the message store
+		void set_ansi_parsing(bool parse) noexcept {
+			m_store->set_ansi_parsing(parse);
+		}
+
+		// sets the sampling, rate limiting and overload behavior applied to incoming messages of the given severity
+		// applies to every terminal sharing the message store
+		void set_ingest_policy(message::severity::severity_t severity, const message_store::ingest_policy& policy) {
+			m_store->set_ingest_policy(severity, policy);
+		}
+
+		// logs a message to the message panel, tagging it with the given channel (see channel(std::string_view))
+		void add_message(message msg, std::string_view channel_name) {
+			msg.channel = channel(channel_name);
+			add_message(std::move(msg));
+		}
+
+		// returns the id of the channel of the given name, registering it in the message store if needed
+		message::channel_id channel(std::string_view name) {
+			return m_store->channel(name);
+		}
+
+		// sets the channels displayed by this terminal (bit n set <=> channel n displayed). Terminal messages are always displayed.
+		void set_channel_mask(message::channel_mask mask) noexcept {
+			m_channel_mask = mask;
+		}
+
+		message::channel_mask channel_mask() const noexcept {
+			return m_channel_mask;
+		}
+
+		// only displays the messages stored in [from, to) (see message_store::stamp). Terminal messages are filtered as well
+		void set_time_range(std::chrono::system_clock::time_point from, std::chrono::system_clock::time_point to) noexcept {
+			m_time_from = from;
+			m_time_to = to;
+		}
+
+		// only displays the messages stored during the last 'window' (ie: the last 30 seconds). The range follows the current time.
+		// combined with the range given to set_time_range. A zero window disables it
+		void set_time_window(std::chrono::system_clock::duration window) noexcept {
+			m_time_window = window;
+		}
+
+		// displays messages whatever their time
+		void reset_time_range() noexcept {
+			m_time_from = std::chrono::system_clock::time_point::min();
+			m_time_to = std::chrono::system_clock::time_point::max();
+			m_time_window = std::chrono::system_clock::duration::zero();
+		}
+
+		// scrolls the message panel to the first displayed message stored at or after time, at the next call to show()
+		// disables autoscroll
+		void jump_to_time(std::chrono::system_clock::time_point time) noexcept {
+			m_jump_to_time = time;
+		}
+
+		// sets the channels whose messages are stored. Messages from other channels are dropped when pushed, without costing storage.
+		// applies to every terminal sharing the message store
+		void set_ingest_channel_mask(message::channel_mask mask) noexcept {
+			m_store->set_ingest_mask(mask);
+		}
+
+		// returns true if messages from the given channel would be stored
+		// may be used by producers to skip formatting messages that would be dropped anyway
+		bool accepts_channel(message::channel_id id) const noexcept {
+			return m_store->accepts(id);
+		}
+
 		// clears the message panel
+		// messages are also removed from the message store if no other terminal uses it
 		void clear();
 
 		message::severity::severity_t log_level() noexcept {
@@ -239,6 +447,26 @@ namespace ImTerm {
 			return m_filter_hint;
 		}
 
+		// set whether the number of messages per severity should be displayed next to the log_level drop down list
+		// counts are those of the messages this terminal displays (channel mask, time range, clear), ignoring the filter and log level
+		void show_level_counts(bool show) noexcept {
+			m_show_level_counts = show;
+		}
+
+		bool show_level_counts() const noexcept {
+			return m_show_level_counts;
+		}
+
+		// messages having more lines than the given threshold are collapsed to their first lines, and can be expanded by the user
+		// 0 to never collapse messages (default)
+		void set_collapse_threshold(unsigned int lines) noexcept {
+			m_collapse_threshold = lines;
+		}
+
+		unsigned int collapse_threshold() const noexcept {
+			return m_collapse_threshold;
+		}
+
 		// allows you to set the text in the log_level drop down list
 		// the std::string_view/s are copied, so you don't need to manage their life-time
 		// set log_level_text() to an empty optional if you want to disable the drop down list
@@ -256,7 +484,39 @@ namespace ImTerm {
 		}
 
 		// Sets the maximum number of saved messages
-		void set_max_log_len(std::vector<message>::size_type max_size);
+		// applies to every terminal sharing the message store
+		void set_max_log_len(message_store::size_type max_size) {
+			m_store->set_max_size(max_size);
+		}
+
+		// Sets the maximum number of bytes held by saved messages, 0 for no limit (default). The oldest messages are evicted first.
+		// applies to every terminal sharing the message store (see message_store::set_max_bytes)
+		void set_max_log_bytes(message_store::size_type max_bytes) {
+			m_store->set_max_bytes(max_bytes);
+		}
+
+		// Sets the maximum number of commands kept in the history, 0 for no limit (default)
+		void set_max_history_len(std::size_t max_size) {
+			m_max_history_len = max_size;
+			trim_history();
+		}
+
+		// memory held by the terminal, in bytes
+		struct memory_usage {
+			std::size_t log_text{0u}; // text of the saved messages, shared with the terminals using the same message store
+			std::size_t log_metadata{0u}; // message records and indexes, shared with the terminals using the same message store
+			std::size_t view{0u}; // messages matching the filter and their layout
+			std::size_t history{0u}; // command history
+			std::size_t completion{0u}; // autocompletion state
+			std::size_t output_buffers{0u}; // output of the commands redirected to @name
+
+			std::size_t total() const noexcept {
+				return log_text + log_metadata + view + history + completion + output_buffers;
+			}
+		};
+
+		// returns an estimation of the memory held by the terminal and its message store
+		memory_usage memory();
 
 		// Sets the size of the terminal
 		void set_size(unsigned int x, unsigned int y) noexcept {
@@ -308,6 +568,71 @@ namespace ImTerm {
 			m_allow_y_resize = allowed;
 		}
 
+		// replaces the command line, as if the user typed it, updating the autocompletion
+		// returns false if text is too long to fit in the command line
+		bool set_command_line(std::string_view text) {
+			if (text.size() >= m_command_buffer.size()) {
+				return false;
+			}
+			std::copy(text.begin(), text.end(), m_command_buffer.begin());
+			m_command_buffer[text.size()] = '\0';
+			m_buffer_usage = text.size();
+			m_current_history_selection = {};
+			if (auto recorder = current_recorder()) {
+				recorder->record_command_line(text);
+			}
+			update_autocomplete();
+			return true;
+		}
+
+		// replaces the text filter, as if the user typed it. Returns false if text is too long to fit in the filter
+		// a non-empty filter is matched against the formatted text: messages whose formatting was deferred are formatted when indexed
+		bool set_filter(std::string_view text) {
+			if (text.size() >= m_log_text_filter_buffer.size()) {
+				return false;
+			}
+			std::copy(text.begin(), text.end(), m_log_text_filter_buffer.begin());
+			m_log_text_filter_buffer[text.size()] = '\0';
+			m_log_text_filter_buffer_usage = text.size();
+			if (auto recorder = current_recorder()) {
+				recorder->record_filter(text);
+			}
+			return true;
+		}
+
+		// records the messages added through add_message, command line and filter edits, executed commands and frames,
+		// to be replayed later (see session_replay). nullptr stops the recording
+		// may be called while other threads add messages: messages added meanwhile may or may not be recorded
+		void record_session(std::shared_ptr<session_recorder> recorder) noexcept {
+			std::atomic_store(&m_recorder, std::move(recorder));
+		}
+
+		// stamps the messages added through add_message, and measures the time between their addition and the first frame
+		// drawing them (see display_latency). Messages that are never drawn, because they are filtered out or scrolled past, are not measured
+		// may be called while other threads add messages: messages added meanwhile may or may not be stamped
+		void set_latency_tracing(bool enabled) noexcept {
+			m_latency_tracing.store(enabled, std::memory_order_relaxed);
+		}
+
+		bool latency_tracing() const noexcept {
+			return m_latency_tracing.load(std::memory_order_relaxed);
+		}
+
+		// delays between the addition of messages and the first frame drawing them, since latency tracing was enabled
+		const latency_histogram& display_latency() const noexcept {
+			return m_display_latency;
+		}
+
+		// longest delay measured during the last frame that drew new messages, see display_latency
+		std::chrono::nanoseconds last_frame_latency() const noexcept {
+			return m_last_frame_latency;
+		}
+
+		void reset_display_latency() noexcept {
+			m_display_latency.reset();
+			m_last_frame_latency = std::chrono::nanoseconds{0};
+		}
+
 	    // executes a statement, simulating user input
 	    // returns false if given string is too long to be interpreted
 	    // if true is returned, any text inputed by the user is overridden
@@ -334,6 +659,9 @@ namespace ImTerm {
 
 		void display_messages() noexcept;
 
+		// records the latency of the messages of m_drawn[0, drawn_count) drawn for the first time (see set_latency_tracing)
+		void trace_latency(std::size_t drawn_count) noexcept;
+
 		void display_command_line() noexcept;
 
 		// displaying command_line itself
@@ -343,10 +671,97 @@ namespace ImTerm {
 
 		void show_autocomplete() noexcept;
 
+		// computes the completions of the command line, after it was edited
+		void update_autocomplete();
+
 		void call_command() noexcept;
 
+		// removes the oldest commands of the history if it is longer than m_max_history_len
+		void trim_history();
+
+		// "command > target" or "command >> target", target being a file path or @name (see get_output_buffer)
+		struct redirection {
+			enum class kind {
+				none,
+				truncate,
+				append,
+			} type{kind::none};
+			std::string target{};
+		};
+
+		// removes the redirection ending command, if any, and stores it in redirect. Only a '>' beginning a word redirects
+		// returns false if the redirection is invalid (no or several targets)
+		bool split_redirection(std::string_view& command, redirection& redirect) const;
+
+		// adds str to the output of the running command, when it is piped or redirected (m_pipe_output is not nullptr)
+		void capture_output(std::string&& str);
+
 		void push_message(message&&);
 
+		void push_message(message&&, std::size_t identity);
+
+		// indexes messages pushed since the last call, and rebuilds the index if the filter, log level, channel mask or time range changed
+		// at most index_chunk_size sequence numbers are indexed per call: returns true if the index is up to date
+		// message store must be locked. compile_filter should be called beforehand, not to compile the filter under the lock
+		bool update_match_index();
+
+		// reports the failure of a redirection to a file, as terminal output. Waits for the writer to be done
+		void report_writer(file_writer& writer);
+
+		// compiles the filter, if regex search is enabled and the filter changed since the last call
+		void compile_filter();
+
+		// the store is unlocked between chunks of indexed sequence numbers (or of laid out messages),
+		// and a frame indexes at most max_indexed_per_frame of them: rebuilding the index of a large store spans several frames
+		static constexpr message_store::size_type index_chunk_size = 4096u;
+		static constexpr message_store::size_type max_indexed_per_frame = 16u * index_chunk_size;
+
+		// end of a line, and beginning of the next one, as indexes in message::value (blanks and new lines in between are not drawn)
+		struct line_break {
+			std::string::size_type end;
+			std::string::size_type next;
+		};
+
+		struct message_layout {
+			float offset; // vertical position in the message panel, relative to an arbitrary origin
+			unsigned int commands_before; // number of commands displayed before this message, for the [-n] indicator
+			unsigned int repeat_count; // repeat count the line breaks were computed for, as the " (xN)" suffix may wrap
+			bool collapsed; // only the first m_collapse_threshold lines are shown
+			std::vector<line_break> line_breaks;
+			// if not 0, line_breaks is empty and the height of the message is estimated from the new lines of its text
+			// messages are only laid out (and formatted, see message::formatter) once visible
+			std::size_t estimated_lines{0u};
+		};
+
+		// copy of the lines of a message drawn in the current frame, so that drawing does not require the message store to be locked
+		struct drawn_message {
+			std::size_t idx; // index in m_layout
+			message_store::seq_type seq;
+			std::size_t first_line; // drawn lines are [first_line, end_line)
+			std::size_t end_line;
+			message text{message::severity::trace, {}, 0u, 0u, false}; // drawn lines, with their colors
+			std::string::size_type text_beg; // position of text.value in the message
+			bool sliced; // if false, text holds the whole message
+			bool empty; // the message's text is empty
+			unsigned int repeat_count;
+			std::chrono::steady_clock::time_point ingest_time; // set if the message is drawn for the first time, and its latency traced
+		};
+
+		// copy of what laying out a message requires, so that messages are laid out without the message store being locked
+		struct layout_source {
+			std::size_t idx; // index in m_layout
+			std::string text;
+			unsigned int repeat_count;
+			bool is_command;
+		};
+
+		// number of elements of m_layout_sources kept from frame to frame, the others being freed
+		static constexpr std::size_t max_kept_layout_sources = 256u;
+
+		// computes the line breaks of a message's text, wrapping lines wider than m_layout_wrap_width if it is not 0
+		// prefix and suffix are drawn before and after the message
+		void compute_layout(std::string_view text, std::string_view prefix, std::string_view suffix, message_layout& layout);
+
 		std::optional<std::string> resolve_history_reference(std::string_view str, bool& modified) const noexcept;
 
 		std::pair<bool, std::string> resolve_history_references(std::string_view str, bool& modified) const;
@@ -384,14 +799,16 @@ namespace ImTerm {
 		//                except if ignore_non_match was set to true
 		std::optional<std::vector<std::string>> split_by_space(std::string_view in, bool ignore_non_match = false) const;
 
-		inline void try_lock()
-		{
-			while (m_flag.test_and_set(std::memory_order_seq_cst)) {}
-		}
+		// Returns the commands of a pipeline ("cmd1 | cmd2"), split on the '|' that are neither quoted nor escaped
+		// Trailing spaces of each command are removed
+		std::vector<std::string_view> split_by_pipe(std::string_view in) const;
 
-		inline void try_unlock()
-		{
-			m_flag.clear(std::memory_order_seq_cst);
+		// Returns in without its trailing spaces (escaped spaces are kept)
+		std::string_view trim_trailing_spaces(std::string_view in) const;
+
+		// current session recorder (see record_session), read from any thread
+		std::shared_ptr<session_recorder> current_recorder() const noexcept {
+			return std::atomic_load(&m_recorder);
 		}
 
 		////////////
@@ -420,10 +837,19 @@ namespace ImTerm {
 		// configuration
 		bool m_autoscroll{true}; // TODO: accessors
 		bool m_autowrap{true};  // TODO: accessors
-		std::vector<std::string>::size_type m_last_size{0u};
+		message_store::seq_type m_last_seen_seq{0u}; // for autoscroll
 		int m_level{message::severity::trace}; // TODO: accessors
+		bool m_show_level_counts{true};
+		unsigned int m_collapse_threshold{0u};
+		// log messages of each severity displayed by this terminal whatever the filter and log level: messages after m_cleared_until,
+		// in the time range and from a channel of m_channel_mask. Updated with the match index
+		std::array<message_store::size_type, message::severity::critical + 1> m_level_counts{};
+		// per severity, indexed messages (sorted sequence numbers) that are not counted as their channel is out of m_channel_mask
+		std::array<message_store::seq_list, message::severity::critical + 1> m_masked_out{};
 #ifdef IMTERM_ENABLE_REGEX
 		bool m_regex_search{true}; // TODO: accessors, button
+		std::optional<std::string> m_compiled_filter{}; // filter m_filter_regex was compiled from (see compile_filter)
+		std::optional<std::regex> m_filter_regex{}; // empty if m_compiled_filter is not a valid regex
 #endif
 
 		std::optional<std::string> m_autoscroll_text;
@@ -443,9 +869,40 @@ namespace ImTerm {
 		// message panel variables
 		unsigned long m_last_flush_at_history{0u}; // for the [-n] indicator on command line
 		bool m_flush_bit{false};
-		std::vector<message> m_logs{};
-		std::vector<message>::size_type m_max_log_len{5'000}; // TODO: command
-		std::vector<message>::size_type m_current_log_oldest_idx{0};
+		std::shared_ptr<message_store> m_store{std::make_shared<message_store>()};
+		message_store::view_id m_view_id{message_store::no_view};
+
+		// incremental index of the messages matching the current filter and log level
+		std::deque<message_store::seq_type> m_matching{}; // sequence numbers, sorted
+		message_store::seq_type m_indexed_until{0u}; // every message before that sequence number was indexed
+		message_store::seq_type m_cleared_until{0u}; // messages before that sequence number were cleared from this terminal
+		std::string m_indexed_filter{};
+		int m_indexed_level{-1};
+		message::channel_mask m_channel_mask{~message::channel_mask{0u}};
+		message::channel_mask m_indexed_channel_mask{~message::channel_mask{0u}};
+		message_store::seq_type m_indexed_generation{~message_store::seq_type{0u}}; // store generation the index is up to date with
+		std::chrono::system_clock::time_point m_time_from{std::chrono::system_clock::time_point::min()};
+		std::chrono::system_clock::time_point m_time_to{std::chrono::system_clock::time_point::max()};
+		std::chrono::system_clock::duration m_time_window{std::chrono::system_clock::duration::zero()};
+		message_store::seq_type m_indexed_time_beg{0u}; // indexed messages are in [m_indexed_time_beg, m_indexed_time_end)
+		message_store::seq_type m_indexed_time_end{~message_store::seq_type{0u}};
+		std::optional<std::chrono::system_clock::time_point> m_jump_to_time{};
+
+		// layout of the indexed messages, so that only the visible ones are drawn
+		std::deque<message_layout> m_layout{}; // layout of the first m_layout.size() messages of m_matching
+		float m_layout_end{0.f}; // vertical position following the last laid out message
+		unsigned int m_layout_commands_end{0u}; // number of commands among the laid out messages
+		float m_layout_width{0.f}; // width of the widest laid out message, when autowrap is disabled
+		float m_layout_font_size{0.f};
+		float m_layout_wrap_width{0.f}; // 0 when autowrap is disabled
+		static constexpr float layout_tolerance = 0.01f; // in pixels, differences below are ignored when comparing sizes
+		unsigned int m_layout_collapse_threshold{0u};
+		std::set<message_store::seq_type> m_expanded_messages{}; // messages above the collapse threshold that were expanded
+		std::vector<drawn_message> m_drawn{}; // reused from frame to frame, only the first elements are valid
+		std::vector<layout_source> m_layout_sources{}; // reused from frame to frame, only the first elements are valid
+
+		std::vector<std::shared_ptr<log_export>> m_exports{}; // running exports, and finished ones not reported yet
+		std::vector<std::weak_ptr<file_tail>> m_file_tails{}; // files polled at each frame
 
 
 		// command line variables
@@ -469,12 +926,22 @@ namespace ImTerm {
 		std::string m_command_line_backup{};
 		std::string_view m_command_line_backup_prefix{};
 		std::vector<std::string> m_command_history{};
+		std::size_t m_max_history_len{0u}; // 0 for no limit
+		std::vector<std::string>* m_pipe_output{nullptr}; // output of the running command when it is piped to another one or redirected
+		file_writer* m_output_writer{nullptr}; // when the output of the running command is redirected to a file
+		std::vector<std::shared_ptr<file_writer>> m_file_writers{}; // redirections to files being written, one writer per file
+		std::map<std::string, std::vector<std::string>, std::less<>> m_output_buffers{}; // redirections to @name
+
+		std::shared_ptr<session_recorder> m_recorder{}; // see record_session. Only accessed through std::atomic_load and std::atomic_store
+
+		std::atomic<bool> m_latency_tracing{false}; // see set_latency_tracing, read by the threads adding messages
+		latency_histogram m_display_latency{};
+		std::chrono::nanoseconds m_last_frame_latency{0};
+		message_store::seq_type m_latency_traced_until{0u}; // messages before this one were already drawn, or skipped
 		std::optional<std::vector<std::string>::iterator> m_current_history_selection{};
 
 		bool m_ignore_next_textinput{false};
 		bool m_has_focus{false};
-
-		std::atomic_flag m_flag;
 	};
 }
 
@@ -19,6 +19,7 @@
 #include <imgui_internal.h>
 #include <array>
 #include <cctype>
+#include <cfloat>
 #include <charconv>
 #include <map>
 #include <optional>
@@ -29,6 +30,7 @@
 #endif
 
 #include "misc.hpp"
+#include "ansi.hpp"
 
 namespace ImTerm {
 namespace details {
@@ -64,6 +66,22 @@ namespace details {
 		return str.size();
 	}
 
+	template <typename T>
+	using sync_commands_method = decltype(std::declval<T&>().sync_commands());
+
+	// returns true if commands references held by the terminal should be dropped
+	template <typename TerminalHelper>
+	bool sync_commands(TerminalHelper& helper) {
+		if constexpr (misc::is_detected_with_return_type_v<sync_commands_method, bool, TerminalHelper>) {
+			return helper.sync_commands();
+		} else {
+			return false;
+		}
+	}
+
+	template <typename T>
+	using find_command_method = decltype(std::declval<T&>().find_command(std::declval<std::string_view>()));
+
 	template <typename T>
 	using set_terminal_method = decltype(std::declval<T&>().set_terminal(std::declval<terminal<T>&>()));
 
@@ -209,6 +227,37 @@ namespace details {
 		return colors;
 	}
 #endif
+
+	// applies the color spans of the message to the parts of a color split that are not highlighted
+	inline void apply_color_spans(std::map<std::string::const_iterator, std::pair<unsigned long, std::optional<theme::constexpr_color>>>& colors,
+	                              const message& msg) {
+		// makes a part start at pos, splitting the part containing it if needed
+		auto split_at = [&colors](std::string::const_iterator pos) {
+			auto it = colors.upper_bound(pos);
+			if (it == colors.begin()) {
+				return;
+			}
+			--it;
+			const auto offset = static_cast<unsigned long>(std::distance(it->first, pos));
+			if (offset == 0u || offset >= it->second.first) {
+				return;
+			}
+			colors.emplace(pos, std::pair{it->second.first - offset, it->second.second});
+			it->second.first = offset;
+		};
+
+		for (const message::color_span& span : msg.color_spans) {
+			auto beg = msg.value.cbegin() + static_cast<std::ptrdiff_t>(std::min<std::string::size_type>(span.beg, msg.value.size()));
+			auto end = msg.value.cbegin() + static_cast<std::ptrdiff_t>(std::min<std::string::size_type>(span.end, msg.value.size()));
+			split_at(beg);
+			split_at(end);
+			for (auto it = colors.lower_bound(beg) ; it != colors.end() && it->first < end ; ++it) {
+				if (!it->second.second) {
+					it->second.second = ansi::to_color(span.rgba);
+				}
+			}
+		}
+	}
 }
 
 template <typename TerminalHelper>
@@ -225,8 +274,8 @@ terminal<TerminalHelper>::terminal(value_type& arg_value, const char* window_nam
 		, m_autowrap_text{"autowrap"}
 		, m_filter_hint{"filter..."}
 {
-	m_flag.clear();
 	assert(m_t_helper != nullptr);
+	m_view_id = m_store->register_view();
 	details::assign_terminal(*m_t_helper, *this);
 
 	std::fill(m_command_buffer.begin(), m_command_buffer.end(), '\0');
@@ -244,6 +293,50 @@ bool terminal<TerminalHelper>::show(const std::vector<config_panels>& panels_ord
 	m_should_show_next_frame = !m_close_request;
 	m_close_request = false;
 
+	if (auto recorder = current_recorder()) {
+		recorder->record_frame();
+	}
+
+	if (details::sync_commands(*m_t_helper)) {
+		m_current_autocomplete.clear();
+	}
+
+	if (!m_file_tails.empty()) {
+		m_file_tails.erase(std::remove_if(m_file_tails.begin(), m_file_tails.end(), [](const std::weak_ptr<file_tail>& weak_tail) {
+			std::shared_ptr<file_tail> tail = weak_tail.lock();
+			if (tail) {
+				tail->poll();
+			}
+			return !tail;
+		}), m_file_tails.end());
+	}
+
+	if (!m_file_writers.empty()) {
+		// writers are closed once a frame went by, then forgotten (and their failures reported) once done
+		m_file_writers.erase(std::remove_if(m_file_writers.begin(), m_file_writers.end(), [this](const std::shared_ptr<file_writer>& writer) {
+			if (!writer->done()) {
+				writer->close();
+				return false;
+			}
+			report_writer(*writer);
+			return true;
+		}), m_file_writers.end());
+	}
+
+	if (!m_exports.empty()) {
+		m_exports.erase(std::remove_if(m_exports.begin(), m_exports.end(), [this](const std::shared_ptr<log_export>& job) {
+			if (!job->done()) {
+				return false;
+			}
+			if (job->get_progress().failed) {
+				add_text_err(job->summary());
+			} else {
+				add_text(job->summary());
+			}
+			return true;
+		}), m_exports.end());
+	}
+
 	if (m_update_height) {
 		if (m_update_width) {
 			ImGui::SetNextWindowSizeConstraints({static_cast<float>(m_base_width), static_cast<float>(m_base_height)},
@@ -308,9 +401,7 @@ bool terminal<TerminalHelper>::show(const std::vector<config_panels>& panels_ord
 	m_current_size = ImGui::GetWindowSize();
 
 	display_settings_bar(panels_order);
-	try_lock();
 	display_messages();
-	try_unlock();
 	display_command_line();
 
 	ImGui::End();
@@ -360,6 +451,10 @@ void terminal<TerminalHelper>::reset_colors() noexcept {
 
 template<typename TerminalHelper>
 void terminal<TerminalHelper>::add_text(std::string str, unsigned int color_beg, unsigned int color_end) {
+	if (m_pipe_output != nullptr) {
+		capture_output(std::move(str));
+		return;
+	}
 	message msg;
 	msg.is_term_message = true;
 	msg.severity = message::severity::info;
@@ -385,16 +480,143 @@ void terminal<TerminalHelper>::add_message(message&& msg) {
 	if (msg.is_term_message && msg.severity != message::severity::warn) {
 		msg.severity = message::severity::info;
 	}
+	if (auto recorder = current_recorder()) {
+		recorder->record_message(msg);
+	}
+	if (m_latency_tracing.load(std::memory_order_relaxed) && msg.ingest_time == std::chrono::steady_clock::time_point{}) {
+		msg.ingest_time = std::chrono::steady_clock::now();
+	}
 	push_message(std::move(msg));
 }
 
+template<typename TerminalHelper>
+void terminal<TerminalHelper>::add_message(message&& msg, std::size_t identity) {
+	if (msg.is_term_message && msg.severity != message::severity::warn) {
+		msg.severity = message::severity::info;
+	}
+	if (auto recorder = current_recorder()) {
+		recorder->record_message(msg, identity);
+	}
+	if (m_latency_tracing.load(std::memory_order_relaxed) && msg.ingest_time == std::chrono::steady_clock::time_point{}) {
+		msg.ingest_time = std::chrono::steady_clock::now();
+	}
+	push_message(std::move(msg), identity);
+}
+
+template <typename TerminalHelper>
+void terminal<TerminalHelper>::set_message_store(std::shared_ptr<message_store> store) {
+	assert(store != nullptr);
+	m_store->unregister_view();
+	m_store = std::move(store);
+	m_view_id = m_store->register_view();
+
+	m_matching.clear();
+	m_layout.clear();
+	for (message_store::seq_list& masked_out : m_masked_out) {
+		masked_out.clear();
+	}
+	m_indexed_until = 0u;
+	m_cleared_until = 0u;
+	m_indexed_generation = ~message_store::seq_type{0u};
+	m_indexed_time_beg = 0u;
+	m_indexed_time_end = ~message_store::seq_type{0u};
+	m_last_seen_seq = 0u;
+	m_latency_traced_until = 0u;
+}
+
 template <typename TerminalHelper>
 void terminal<TerminalHelper>::clear() {
 	m_flush_bit = true;
-	try_lock();
-	m_logs.clear();
-	m_current_log_oldest_idx = 0u;
-	try_unlock();
+	if (m_store->view_count() == 1u) { // not shared with other terminals
+		m_store->clear();
+	}
+	m_store->lock();
+	m_cleared_until = m_store->end_seq();
+	m_store->unlock();
+
+	m_matching.clear();
+	m_layout.clear();
+	m_indexed_until = m_cleared_until;
+	m_indexed_generation = ~message_store::seq_type{0u};
+}
+
+template <typename TerminalHelper>
+std::shared_ptr<log_export> terminal<TerminalHelper>::export_messages(std::string path, log_export::format fmt, bool filtered) {
+	std::vector<message_store::seq_type> seqs;
+	compile_filter();
+	m_store->lock();
+	if (filtered) {
+		while (!update_match_index()) { // letting producers in between chunks
+			m_store->unlock();
+			m_store->lock();
+		}
+		seqs.assign(m_matching.begin(), m_matching.end());
+	} else {
+		for (message_store::seq_type seq = std::max(m_cleared_until, m_store->first_seq()) ; seq < m_store->end_seq() ; ++seq) {
+			if (!m_store->at(seq).is_term_message || m_store->origin(seq) == m_view_id) {
+				seqs.push_back(seq);
+			}
+		}
+	}
+	m_store->unlock();
+
+	return m_exports.emplace_back(std::make_shared<log_export>(m_store, std::move(seqs), std::move(path), fmt));
+}
+
+template <typename TerminalHelper>
+typename terminal<TerminalHelper>::memory_usage terminal<TerminalHelper>::memory() {
+	memory_usage usage;
+
+	m_store->lock();
+	const message_store::memory_usage store_usage = m_store->memory();
+	m_store->unlock();
+	usage.log_text = store_usage.text;
+	usage.log_metadata = store_usage.metadata;
+
+	auto heap_bytes = [](const std::string& str) -> std::size_t {
+		return str.capacity() > std::string{}.capacity() ? str.capacity() + 1 : 0u; // short strings are not allocated
+	};
+
+	usage.view = m_matching.size() * sizeof(message_store::seq_type) + m_layout.size() * sizeof(message_layout)
+	             + m_expanded_messages.size() * (sizeof(message_store::seq_type) + 4 * sizeof(void*)); // approximation of a tree node
+	for (const message_layout& layout : m_layout) {
+		usage.view += layout.line_breaks.capacity() * sizeof(line_break);
+	}
+
+	usage.history = m_command_history.capacity() * sizeof(std::string);
+	for (const std::string& cmd : m_command_history) {
+		usage.history += heap_bytes(cmd);
+	}
+
+	usage.completion = m_current_autocomplete.capacity() * sizeof(command_type_cref)
+	                   + m_current_autocomplete_strings.capacity() * sizeof(std::string) + heap_bytes(m_command_line_backup);
+	for (const std::string& str : m_current_autocomplete_strings) {
+		usage.completion += heap_bytes(str);
+	}
+
+	for (const auto& buffer : m_output_buffers) {
+		usage.output_buffers += heap_bytes(buffer.first) + buffer.second.capacity() * sizeof(std::string) + 4 * sizeof(void*); // tree node
+		for (const std::string& line : buffer.second) {
+			usage.output_buffers += heap_bytes(line);
+		}
+	}
+
+	return usage;
+}
+
+template <typename TerminalHelper>
+void terminal<TerminalHelper>::report_writer(file_writer& writer) {
+	writer.wait();
+	if (writer.failed()) {
+		add_text_err("redirection to " + writer.path() + " failed");
+	}
+}
+
+template <typename TerminalHelper>
+std::shared_ptr<file_tail> terminal<TerminalHelper>::tail_file(std::string path, file_tail::options opts) {
+	auto tail = std::make_shared<file_tail>(m_store, std::move(path), std::move(opts));
+	m_file_tails.emplace_back(tail);
+	return tail;
 }
 
 template <typename TerminalHelper>
@@ -449,23 +671,6 @@ void terminal<TerminalHelper>::set_min_log_level(message::severity::severity_t l
 	}
 }
 
-template <typename TerminalHelper>
-void terminal<TerminalHelper>::set_max_log_len(std::vector<message>::size_type max_size) {
-	try_lock();
-	std::vector<message> new_msg_vect;
-	new_msg_vect.reserve(max_size);
-	for (auto i = 0u ; i < std::min(max_size, m_logs.size() - m_current_log_oldest_idx) ; ++i) {
-		new_msg_vect.emplace_back(std::move(m_logs[i + m_current_log_oldest_idx]));
-	}
-	for (auto i = 0u ; i < std::min(max_size - new_msg_vect.size(), m_logs.size() - new_msg_vect.size()) ; ++i) {
-		new_msg_vect.emplace_back(std::move(m_logs[i]));
-	}
-	m_logs = std::move(new_msg_vect);
-	m_current_log_oldest_idx = 0u;
-	m_max_log_len = max_size;
-	try_unlock();
-}
-
 template <typename TerminalHelper>
 void terminal<TerminalHelper>::try_log(std::string_view str, message::type type) {
 	message::severity::severity_t severity;
@@ -507,7 +712,20 @@ void terminal<TerminalHelper>::display_settings_bar(const std::vector<config_pan
 
 	const float loglevel_selector_size = !m_log_level_text ? 0.f : ImGui::CalcTextSize(m_longest_log_level).x + ImGui::GetFrameHeight() + ImGui::GetStyle().ItemInnerSpacing.x * 2.f;
 
-	const float loglevel_global_size = !m_log_level_text ? 0.f : ImGui::CalcTextSize(m_log_level_text->data()).x + ImGui::GetStyle().ItemSpacing.x + loglevel_selector_size;
+	// number of displayed messages per selectable severity, displayed after the log level selector
+	std::array<small_buffer_type, message::severity::critical + 1> level_counts{};
+	std::array<unsigned, message::severity::critical + 1> level_counts_len{};
+	float level_counts_size = 0.f;
+	if (m_log_level_text && m_show_level_counts) {
+		for (auto i = static_cast<std::size_t>(m_lowest_log_level_val) ; i < level_counts.size() ; ++i) {
+			std::to_chars_result res = std::to_chars(level_counts[i].data(), level_counts[i].data() + level_counts[i].size(), m_level_counts[i]);
+			level_counts_len[i] = static_cast<unsigned>(res.ptr - level_counts[i].data());
+			level_counts_size += ImGui::CalcTextSize(level_counts[i].data(), res.ptr).x + ImGui::GetStyle().ItemInnerSpacing.x;
+		}
+		level_counts_size += ImGui::GetStyle().ItemSpacing.x - ImGui::GetStyle().ItemInnerSpacing.x;
+	}
+
+	const float loglevel_global_size = !m_log_level_text ? 0.f : ImGui::CalcTextSize(m_log_level_text->data()).x + ImGui::GetStyle().ItemSpacing.x + loglevel_selector_size + level_counts_size;
 
 	unsigned space_consumer_count = 0u;
 	float required_space = ImGui::GetStyle().ItemSpacing.x * (panels_order.size() - 1);
@@ -557,6 +775,9 @@ void terminal<TerminalHelper>::display_settings_bar(const std::vector<config_pan
 			ImGui::PushItemWidth(size);
 			if (ImGui::InputTextWithHint("##terminal:settings:text_filter", m_filter_hint->data(), m_log_text_filter_buffer.data(), m_log_text_filter_buffer.size())) {
 				m_log_text_filter_buffer_usage = misc::strnlen(m_log_text_filter_buffer.data(), m_log_text_filter_buffer.size());
+				if (auto recorder = current_recorder()) {
+					recorder->record_filter({m_log_text_filter_buffer.data(), m_log_text_filter_buffer_usage});
+				}
 			}
 			ImGui::PopItemWidth();
 
@@ -609,6 +830,17 @@ void terminal<TerminalHelper>::display_settings_bar(const std::vector<config_pan
 					ImGui::PushItemWidth(loglevel_selector_size);
 					ImGui::Combo("##terminal:log_level_selector:combo", &m_level, m_lowest_log_level);
 					ImGui::PopItemWidth();
+
+					if (m_show_level_counts) {
+						float spacing = ImGui::GetStyle().ItemSpacing.x;
+						for (auto lvl = static_cast<std::size_t>(m_lowest_log_level_val) ; lvl < level_counts.size() ; ++lvl) {
+							ImGui::SameLine(0.f, spacing);
+							int pop = try_push_style(ImGuiCol_Text, m_colors.log_level_colors[lvl]);
+							ImGui::TextUnformatted(level_counts[lvl].data(), level_counts[lvl].data() + level_counts_len[lvl]);
+							ImGui::PopStyleColor(pop);
+							spacing = ImGui::GetStyle().ItemInnerSpacing.x;
+						}
+					}
 				} else {
 					ImGui::Dummy(ImVec2(loglevel_global_size, 1.f));
 				}
@@ -633,24 +865,31 @@ void terminal<TerminalHelper>::display_messages() noexcept {
 		if (ImGui::BeginChild("terminal:logs_window", ImVec2(avail_space.x, avail_space.y - commandline_height), false,
 		                      ImGuiWindowFlags_HorizontalScrollbar | ImGuiWindowFlags_NoTitleBar)) {
 
-			unsigned traced_count = 0;
-			void (*text_formatted) (const char*, ...);
-			if (m_autowrap) {
-				text_formatted = ImGui::TextWrapped;
-			} else {
-				text_formatted = ImGui::Text;
-			}
+			auto is_command = [](const message& msg) {
+				return msg.is_term_message && msg.severity == message::severity::trace;
+			};
 
-			auto print_single_message = [this, &traced_count, &text_formatted](const message& msg){
-				if (msg.severity < (m_level + m_lowest_log_level_val) && !msg.is_term_message) {
-					return;
-				}
+			// [-n] indicator, displayed before commands. command_idx: number of commands displayed before this one
+			auto command_prefix = [this](unsigned int command_idx) {
+				return "[" + std::to_string(static_cast<int>(command_idx + m_last_flush_at_history - m_command_history.size())) + "] ";
+			};
+
+			auto repeat_suffix = [](unsigned int repeat_count) {
+				return repeat_count > 1 ? " (x" + std::to_string(repeat_count) + ")" : std::string{};
+			};
 
-				if (msg.value.empty()) {
+			// draws the lines of a message copied by snapshot_message, the first one being drawn at the current cursor position
+			auto print_single_message = [&](const drawn_message& drawn, unsigned int command_idx, const message_layout& layout) {
+				if (drawn.empty) {
 					ImGui::NewLine();
 					return;
 				}
 
+				const message& msg = drawn.text;
+				const std::string::size_type text_beg = drawn.text_beg;
+				const std::size_t first_line = drawn.first_line;
+				const std::size_t end_line = drawn.end_line;
+
 				std::map<std::string::const_iterator, std::pair<unsigned long, std::optional<theme::constexpr_color>>> colors;
 #ifdef IMTERM_ENABLE_REGEX
 				if (m_regex_search) {
@@ -669,8 +908,33 @@ void terminal<TerminalHelper>::display_messages() noexcept {
 				colors = details::simple_colors_split(filter, msg, m_colors.matching_text);
 #endif
 				if (colors.empty()) {
-					return;
+					if (!drawn.sliced) {
+						return;
+					}
+					colors = details::simple_colors_split({}, msg, m_colors.matching_text); // the match is in lines that are not drawn
 				}
+				details::apply_color_spans(colors, msg);
+
+				// colored parts are drawn line by line, following the line breaks of the layout
+				auto next_break = layout.line_breaks.cbegin() + static_cast<std::ptrdiff_t>(first_line);
+				const auto breaks_end = layout.line_breaks.cbegin() + static_cast<std::ptrdiff_t>(std::min(end_line, layout.line_breaks.size() + 1) - 1);
+				std::string::size_type skipped_until = 0u;
+				auto draw_text = [&](std::string::size_type beg, std::string::size_type end) {
+					beg = std::max(beg, skipped_until);
+					while (beg < end) {
+						if (next_break != breaks_end && next_break->end - text_beg <= beg) {
+							ImGui::NewLine();
+							skipped_until = next_break->next - text_beg;
+							beg = std::max(beg, skipped_until);
+							++next_break;
+							continue;
+						}
+						const std::string::size_type line_end = next_break != breaks_end ? std::min(end, next_break->end - text_beg) : end;
+						ImGui::TextUnformatted(msg.value.data() + beg, msg.value.data() + line_end);
+						ImGui::SameLine(0.f, 0.f);
+						beg = line_end;
+					}
+				};
 
 				unsigned int msg_col_pop = 0u;
 				for (const auto& color : colors) {
@@ -678,9 +942,11 @@ void terminal<TerminalHelper>::display_messages() noexcept {
 						if (msg.is_term_message) {
 							if (msg.severity == message::severity::trace) {
 								msg_col_pop += try_push_style(ImGuiCol_Text, m_colors.cmd_backlog);
-								text_formatted("[%d] ", static_cast<int>(traced_count + m_last_flush_at_history - m_command_history.size()));
-								++traced_count;
-								ImGui::SameLine(0.f, 0.f);
+								if (first_line == 0) {
+									std::string prefix = command_prefix(command_idx);
+									ImGui::TextUnformatted(prefix.data(), prefix.data() + prefix.size());
+									ImGui::SameLine(0.f, 0.f);
+								}
 							} else if (msg.severity == message::severity::debug) {
 								msg_col_pop += try_push_style(ImGuiCol_Text, m_colors.cmd_history_completed);
 							} else {
@@ -696,37 +962,330 @@ void terminal<TerminalHelper>::display_messages() noexcept {
 					}
 					if (color.second.first != 0) {
                         const int pop = try_push_style(ImGuiCol_Text, color.second.second);
-                        text_formatted("%.*s", color.second.first, &*color.first);
+                        const auto beg = static_cast<std::string::size_type>(color.first - msg.value.begin());
+                        draw_text(beg, beg + color.second.first);
                         ImGui::PopStyleColor(pop);
-                        ImGui::SameLine(0.f, 0.f);
 					}
 				}
 				ImGui::PopStyleColor(msg_col_pop);
+				for (; next_break != breaks_end ; ++next_break) {
+					ImGui::NewLine();
+				}
+				if (drawn.repeat_count > 1 && end_line > layout.line_breaks.size()) {
+					std::string suffix = repeat_suffix(drawn.repeat_count);
+					ImGui::TextUnformatted(suffix.data(), suffix.data() + suffix.size());
+					ImGui::SameLine(0.f, 0.f);
+				}
 				ImGui::NewLine();
 			};
-			if (m_current_log_oldest_idx < m_logs.size())
-			{
-				for (size_t i = m_current_log_oldest_idx ; i < m_logs.size() ; ++i) {
-					print_single_message(m_logs[i]);
+			// the store is only locked, by chunks, to update the index and estimate the height of new messages,
+			// then to copy the visible messages: layout and drawing are done from the copies
+			const float wrap_width = m_autowrap ? ImGui::GetContentRegionAvail().x : 0.f;
+			if (misc::differs(ImGui::GetFontSize(), m_layout_font_size, layout_tolerance) || misc::differs(wrap_width, m_layout_wrap_width, layout_tolerance)
+			    || m_collapse_threshold != m_layout_collapse_threshold) {
+				m_layout.clear();
+				m_layout_font_size = ImGui::GetFontSize();
+				m_layout_wrap_width = wrap_width;
+				m_layout_collapse_threshold = m_collapse_threshold;
+			}
+
+			const float line_height = ImGui::GetTextLineHeightWithSpacing();
+			auto line_count = [](const message_layout& layout) {
+				return layout.estimated_lines != 0u ? layout.estimated_lines : layout.line_breaks.size() + 1;
+			};
+			auto is_collapsible = [&](const message_layout& layout) {
+				return m_collapse_threshold != 0 && line_count(layout) > m_collapse_threshold;
+			};
+			auto shown_line_count = [&](const message_layout& layout) {
+				return layout.collapsed ? std::size_t{m_collapse_threshold} : line_count(layout);
+			};
+			auto height_of = [&](const message_layout& layout) {
+				// collapsible messages are followed by the line used to collapse or expand them
+				return static_cast<float>(shown_line_count(layout) + (is_collapsible(layout) ? 1u : 0u)) * line_height;
+			};
+
+			// new matching messages are given an estimated height (see message_layout::estimated_lines) without being copied:
+			// only the visible ones are copied and laid out. Returns true if every matching message has a layout. Store must be locked
+			auto add_estimated_layouts = [&]() {
+				if (m_layout.empty()) {
+					m_layout_end = 0.f;
+					m_layout_commands_end = 0u;
+					m_layout_width = 0.f;
+				}
+				const std::size_t end_idx = std::min(m_matching.size(), m_layout.size() + index_chunk_size);
+				for (std::size_t idx = m_layout.size() ; idx < end_idx ; ++idx) {
+					const message& msg = m_store->at(m_matching[idx]);
+					message_layout& layout = m_layout.emplace_back();
+					layout.offset = m_layout_end;
+					layout.commands_before = m_layout_commands_end;
+					layout.repeat_count = msg.repeat_count;
+					layout.estimated_lines = 1u + static_cast<std::size_t>(std::count(msg.value.begin(), msg.value.end(), '\n'));
+					layout.collapsed = is_collapsible(layout) && m_expanded_messages.count(m_matching[idx]) == 0;
+					m_layout_end += height_of(layout);
+					m_layout_commands_end += is_command(msg) ? 1u : 0u;
+				}
+				return end_idx == m_matching.size();
+			};
+
+			compile_filter();
+			message_store::seq_type first_seq = 0u;
+			std::optional<message_store::seq_type> jump_seq;
+			for (message_store::size_type indexed = 0u ; ; indexed += index_chunk_size) {
+				m_store->lock();
+				const bool up_to_date = update_match_index();
+				const bool laid_out = add_estimated_layouts();
+				first_seq = m_store->first_seq();
+				if (m_jump_to_time) {
+					jump_seq = m_store->seq_at(*m_jump_to_time);
+					m_jump_to_time.reset();
+				}
+				m_store->unlock();
+				if ((up_to_date && laid_out) || indexed + index_chunk_size >= max_indexed_per_frame) {
+					break;
 				}
-				for (size_t i = 0u ; i < m_current_log_oldest_idx ; ++i) {
-					print_single_message(m_logs[i]);
+			}
+
+			if (!m_layout.empty() && m_layout.front().offset > 1e6f) { // keeping offsets small enough for floats to stay accurate
+				const float shift = m_layout.front().offset;
+				for (message_layout& layout : m_layout) {
+					layout.offset -= shift;
 				}
+				m_layout_end -= shift;
+			}
+			while (!m_expanded_messages.empty() && *m_expanded_messages.begin() < first_seq) {
+				m_expanded_messages.erase(m_expanded_messages.begin());
 			}
+
+			const float top = ImGui::GetCursorPosY();
+			const float origin = m_layout.empty() ? 0.f : m_layout.front().offset;
+			const unsigned int commands_origin = m_layout.empty() ? 0u : m_layout.front().commands_before;
+			auto position_of = [&](float offset) {
+				return top + offset - origin;
+			};
+
+			// copies what laying out a message requires
+			std::size_t source_count = 0u;
+			auto copy_source = [&](std::size_t idx, const message& msg) {
+				if (source_count == m_layout_sources.size()) {
+					m_layout_sources.emplace_back();
+				}
+				layout_source& source = m_layout_sources[source_count++];
+				source.idx = idx;
+				source.repeat_count = msg.repeat_count;
+				source.is_command = is_command(msg);
+				source.text.assign(msg.value);
+			};
+			auto layout_message = [&](const layout_source& source, message_layout& layout) {
+				layout.repeat_count = source.repeat_count;
+				layout.estimated_lines = 0u;
+				compute_layout(source.text, source.is_command ? command_prefix(layout.commands_before - commands_origin) : std::string{},
+				               repeat_suffix(source.repeat_count), layout);
+				layout.collapsed = is_collapsible(layout) && m_expanded_messages.count(m_matching[source.idx]) == 0;
+			};
+			auto resize = [&](std::size_t idx, float previous_height) {
+				const float shift = height_of(m_layout[idx]) - previous_height;
+				if (misc::differs(shift, 0.f, layout_tolerance)) {
+					std::for_each(m_layout.begin() + static_cast<std::ptrdiff_t>(idx) + 1, m_layout.end(), [shift](message_layout& next) {
+						next.offset += shift;
+					});
+					m_layout_end += shift;
+				}
+			};
+
+			if (jump_seq) {
+				const auto target = std::lower_bound(m_matching.begin(), m_matching.end(), *jump_seq);
+				const auto idx = static_cast<std::size_t>(target - m_matching.begin());
+				ImGui::SetScrollY(position_of(idx < m_layout.size() ? m_layout[idx].offset : m_layout_end));
+				m_autoscroll = false;
+			}
+
+			// only the visible lines of the visible messages are drawn
+			const float visible_beg = ImGui::GetScrollY();
+			const float visible_end = visible_beg + ImGui::GetWindowHeight();
+			auto first_visible = [&]() {
+				auto it = std::upper_bound(m_layout.begin(), m_layout.end(), visible_beg, [&](float y, const message_layout& layout) {
+					return y < position_of(layout.offset);
+				});
+				return it == m_layout.begin() ? std::size_t{0u} : static_cast<std::size_t>(it - m_layout.begin()) - 1;
+			};
+			auto is_visible = [&](std::size_t idx) {
+				return idx < m_layout.size() && position_of(m_layout[idx].offset) < visible_end;
+			};
+
+			// visible messages that were repeated since they were laid out, or whose height was estimated, are laid out again.
+			// As their height may change which messages are visible, this is repeated a few times
+			for (int pass = 0 ; pass < 3 ; ++pass) {
+				source_count = 0u;
+				m_store->lock();
+				for (std::size_t idx = first_visible() ; is_visible(idx) ; ++idx) {
+					if (m_matching[idx] < m_store->first_seq()) {
+						continue; // evicted since the index was updated
+					}
+					const message& msg = m_store->at(m_matching[idx]);
+					if (msg.repeat_count != m_layout[idx].repeat_count || m_layout[idx].estimated_lines != 0u) {
+						copy_source(idx, m_store->formatted(m_matching[idx]));
+					}
+				}
+				m_store->unlock();
+				if (source_count == 0u) {
+					break;
+				}
+				for (auto source = m_layout_sources.cbegin() ; source != m_layout_sources.cbegin() + static_cast<std::ptrdiff_t>(source_count) ; ++source) {
+					const float previous_height = height_of(m_layout[source->idx]);
+					layout_message(*source, m_layout[source->idx]);
+					resize(source->idx, previous_height);
+				}
+			}
+			if (m_layout_sources.size() > max_kept_layout_sources) {
+				m_layout_sources.resize(max_kept_layout_sources);
+			}
+
+			// copies the visible lines of a message, updating its layout if it was repeated since it was laid out
+			layout_source late_source;
+			auto snapshot_message = [&](std::size_t idx, drawn_message& drawn) {
+				message_layout& layout = m_layout[idx];
+				const message_store::seq_type seq = m_matching[idx];
+				drawn.idx = idx;
+				drawn.seq = seq;
+				if (seq < m_store->first_seq()) {
+					// evicted since the index was updated (the store was not locked meanwhile): removed from the index next frame
+					drawn.first_line = drawn.end_line = 0u;
+					drawn.repeat_count = layout.repeat_count;
+					drawn.empty = true;
+					drawn.ingest_time = {};
+					return;
+				}
+
+				const message& msg = m_store->formatted(seq);
+				if (msg.repeat_count != layout.repeat_count || layout.estimated_lines != 0u) {
+					// only if the message became visible or was repeated since the layout passes
+					late_source.idx = idx;
+					late_source.repeat_count = msg.repeat_count;
+					late_source.is_command = is_command(msg);
+					late_source.text.assign(msg.value);
+					const float previous_height = height_of(layout);
+					layout_message(late_source, layout);
+					resize(idx, previous_height);
+				}
+
+				const float msg_top = position_of(layout.offset);
+				const std::size_t shown_lines = shown_line_count(layout);
+				drawn.first_line = static_cast<std::size_t>(std::clamp((visible_beg - msg_top) / line_height, 0.f, static_cast<float>(shown_lines)));
+				drawn.end_line = std::min(shown_lines, static_cast<std::size_t>(std::max((visible_end - msg_top) / line_height, 0.f)) + 1);
+				drawn.repeat_count = msg.repeat_count;
+				drawn.empty = msg.value.empty();
+				drawn.ingest_time = latency_tracing() && seq >= m_latency_traced_until ? msg.ingest_time : std::chrono::steady_clock::time_point{};
+				if (drawn.first_line >= drawn.end_line || drawn.empty) {
+					drawn.text_beg = 0u;
+					drawn.sliced = false;
+					drawn.text.value.clear();
+					drawn.text.color_spans.clear();
+					return;
+				}
+
+				// only the drawn lines are copied (and colorized), not to go through the whole text of large messages
+				const std::string::size_type text_beg = drawn.first_line == 0 ? 0u : layout.line_breaks[drawn.first_line - 1].next;
+				const std::string::size_type text_end = drawn.end_line > layout.line_breaks.size() ? msg.value.size() : layout.line_breaks[drawn.end_line - 1].end;
+				auto clamp = [&](std::string::size_type pos) {
+					return std::clamp(pos, text_beg, text_end) - text_beg;
+				};
+				drawn.text_beg = text_beg;
+				drawn.sliced = text_beg != 0u || text_end != msg.value.size();
+				drawn.text.severity = msg.severity;
+				drawn.text.value.assign(msg.value, text_beg, text_end - text_beg);
+				drawn.text.color_beg = clamp(msg.color_beg);
+				drawn.text.color_end = clamp(msg.color_end);
+				drawn.text.is_term_message = msg.is_term_message;
+				drawn.text.color_spans.clear();
+				for (const message::color_span& span : msg.color_spans) {
+					if (span.end > text_beg && span.beg < text_end) {
+						drawn.text.color_spans.push_back({static_cast<std::uint32_t>(clamp(span.beg)), static_cast<std::uint32_t>(clamp(span.end)), span.rgba});
+					}
+				}
+			};
+
+			std::size_t drawn_count = 0u;
+			m_store->lock();
+			for (std::size_t idx = first_visible() ; is_visible(idx) ; ++idx) {
+				if (drawn_count == m_drawn.size()) {
+					m_drawn.emplace_back();
+				}
+				snapshot_message(idx, m_drawn[drawn_count++]);
+			}
+			m_store->unlock();
+
+			auto draw_message = [&](const drawn_message& drawn) {
+				message_layout& layout = m_layout[drawn.idx];
+				const float msg_top = position_of(layout.offset);
+				if (drawn.first_line < drawn.end_line) {
+					ImGui::SetCursorPosY(msg_top + static_cast<float>(drawn.first_line) * line_height);
+					print_single_message(drawn, layout.commands_before - commands_origin, layout);
+				}
+
+				if (is_collapsible(layout)) {
+					const std::size_t shown_lines = shown_line_count(layout);
+					ImGui::SetCursorPosY(msg_top + static_cast<float>(shown_lines) * line_height);
+					std::string label = layout.collapsed
+							? "[+] " + std::to_string(line_count(layout) - shown_lines) + " more lines"
+							: std::string{"[-] collapse"};
+					ImGui::PushID(static_cast<int>(drawn.seq));
+					if (ImGui::Selectable(label.c_str())) {
+						const float previous_height = height_of(layout);
+						layout.collapsed = !layout.collapsed;
+						if (layout.collapsed) {
+							m_expanded_messages.erase(drawn.seq);
+						} else {
+							m_expanded_messages.insert(drawn.seq);
+						}
+						resize(drawn.idx, previous_height);
+					}
+					ImGui::PopID();
+				}
+			};
+
+			std::for_each(m_drawn.cbegin(), m_drawn.cbegin() + static_cast<std::ptrdiff_t>(drawn_count), draw_message);
+
+			if (latency_tracing() && drawn_count != 0u) {
+				trace_latency(drawn_count);
+			}
+
+			// reserving the space of the messages that were not drawn. Also used by SetScrollHereY as the last item
+			ImGui::SetCursorPosY(position_of(m_layout_end));
+			ImGui::Dummy(ImVec2(m_layout_width, 0.f));
 		}
 		if (m_autoscroll) {
-			if (m_last_size != m_logs.size()) {
+			if (m_last_seen_seq != m_indexed_until) {
 				ImGui::SetScrollHereY(1.f);
-				m_last_size = m_logs.size();
+				m_last_seen_seq = m_indexed_until;
 			}
 		} else {
-			m_last_size = 0u;
+			m_last_seen_seq = 0u;
 		}
 		ImGui::PopStyleColor(style_push_count);
 		ImGui::EndChild();
 	}
 }
 
+template <typename TerminalHelper>
+void terminal<TerminalHelper>::trace_latency(std::size_t drawn_count) noexcept {
+	const auto now = std::chrono::steady_clock::now();
+	std::optional<std::chrono::nanoseconds> frame_latency;
+	for (auto it = m_drawn.cbegin() ; it != m_drawn.cbegin() + static_cast<std::ptrdiff_t>(drawn_count) ; ++it) {
+		if (it->first_line >= it->end_line) {
+			continue;
+		}
+		if (it->ingest_time != std::chrono::steady_clock::time_point{}) {
+			const auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(now - it->ingest_time);
+			m_display_latency.record(latency);
+			frame_latency = std::max(frame_latency.value_or(latency), latency);
+		}
+		m_latency_traced_until = std::max(m_latency_traced_until, it->seq + 1);
+	}
+	if (frame_latency) {
+		m_last_frame_latency = *frame_latency;
+	}
+}
+
 template <typename TerminalHelper>
 void terminal<TerminalHelper>::display_command_line() noexcept {
 	if (!m_command_entered && ImGui::GetActiveID() == m_input_text_id && m_input_text_id != 0 && m_current_autocomplete.empty()) {
@@ -762,53 +1321,61 @@ void terminal<TerminalHelper>::show_input_text() noexcept {
 			m_buffer_usage = misc::strnlen(m_command_buffer.data(), m_command_buffer.size());
 		}
 
-		if (m_autocomplete_pos != position::nowhere) {
+		if (auto recorder = current_recorder()) {
+			recorder->record_command_line({m_command_buffer.data(), m_buffer_usage});
+		}
+		update_autocomplete();
+	}
+	m_ignore_next_textinput = false;
+	ImGui::PopItemWidth();
+
+	if (m_input_text_id == 0u) {
+		m_input_text_id = ImGui::GetItemID();
+	}
+}
 
-			int sp_count = 0;
-			auto is_space_lbd = [this, &sp_count](char c) {
+template <typename TerminalHelper>
+void terminal<TerminalHelper>::update_autocomplete() {
+	if (m_autocomplete_pos != position::nowhere) {
+
+		int sp_count = 0;
+		auto is_space_lbd = [this, &sp_count](char c) {
+			if (sp_count > 0) {
+				--sp_count;
+				return true;
+			} else {
+				sp_count = is_space({&c, static_cast<unsigned>(m_command_buffer.data() + m_buffer_usage - &c)});
 				if (sp_count > 0) {
 					--sp_count;
 					return true;
-				} else {
-					sp_count = is_space({&c, static_cast<unsigned>(m_command_buffer.data() + m_buffer_usage - &c)});
-					if (sp_count > 0) {
-						--sp_count;
-						return true;
-					}
-					return false;
-				}
-			};
-			char* beg = std::find_if_not(m_command_buffer.data(), m_command_buffer.data() + m_buffer_usage,
-			                            is_space_lbd);
-			sp_count = 0;
-			const char* ed = std::find_if(beg, m_command_buffer.data() + m_buffer_usage, is_space_lbd);
-
-			if (ed == m_command_buffer.data() + m_buffer_usage) {
-				m_current_autocomplete = m_t_helper->find_commands_by_prefix(beg, ed);
-				m_current_autocomplete_strings.clear();
-				m_command_entered = true;
-			} else {
-				m_command_entered = false;
-				m_current_autocomplete.clear();
-				std::vector<command_type_cref> cmds = m_t_helper->find_commands_by_prefix(beg, ed);
-
-				if (!cmds.empty()) {
-					std::string_view sv{m_command_buffer.data(), m_buffer_usage};
-					std::optional<std::vector<std::string>> splitted = split_by_space(sv, true);
-					assert(splitted);
-					argument_type arg{m_argument_value, *this, *splitted};
-					m_current_autocomplete_strings = cmds[0].get().complete(arg);
 				}
+				return false;
 			}
+		};
+		char* beg = std::find_if_not(m_command_buffer.data(), m_command_buffer.data() + m_buffer_usage,
+		                            is_space_lbd);
+		sp_count = 0;
+		const char* ed = std::find_if(beg, m_command_buffer.data() + m_buffer_usage, is_space_lbd);
+
+		if (ed == m_command_buffer.data() + m_buffer_usage) {
+			m_current_autocomplete = m_t_helper->find_commands_by_prefix(beg, ed);
+			m_current_autocomplete_strings.clear();
+			m_command_entered = true;
 		} else {
 			m_command_entered = false;
+			m_current_autocomplete.clear();
+			std::vector<command_type_cref> cmds = m_t_helper->find_commands_by_prefix(beg, ed);
+
+			if (!cmds.empty()) {
+				std::string_view sv{m_command_buffer.data(), m_buffer_usage};
+				std::optional<std::vector<std::string>> splitted = split_by_space(sv, true);
+				assert(splitted);
+				argument_type arg{m_argument_value, *this, *splitted};
+				m_current_autocomplete_strings = cmds[0].get().complete(arg);
+			}
 		}
-	}
-	m_ignore_next_textinput = false;
-	ImGui::PopItemWidth();
-
-	if (m_input_text_id == 0u) {
-		m_input_text_id = ImGui::GetItemID();
+	} else {
+		m_command_entered = false;
 	}
 }
 
@@ -966,9 +1533,13 @@ void terminal<TerminalHelper>::call_command() noexcept {
 	if (m_buffer_usage == 0) {
 		return;
 	}
+	if (auto recorder = current_recorder()) {
+		recorder->record_execute({m_command_buffer.data(), m_buffer_usage});
+	}
 
 	m_current_autocomplete_strings.clear();
 	m_current_autocomplete.clear();
+	details::sync_commands(*m_t_helper);
 
 	bool modified{};
 	std::pair<bool, std::string> resolved = resolve_history_references({m_command_buffer.data(), m_buffer_usage}, modified);
@@ -978,33 +1549,200 @@ void terminal<TerminalHelper>::call_command() noexcept {
 		return;
 	}
 
-	std::optional<std::vector<std::string>> splitted = split_by_space(resolved.second);
-	if (!splitted) {
-		try_log({m_command_buffer.data(), m_buffer_usage}, message::type::user_input);
-		try_log("Unmatched \"", message::type::error);
-		return;
+	// resolved.second has ownership over stages and over the command lines
+	std::vector<std::string_view> stages = split_by_pipe(resolved.second);
+
+	// only the last command of a pipeline may be redirected
+	redirection redirect;
+	bool valid_redirection = true;
+	for (std::string_view& stage : stages) {
+		valid_redirection = valid_redirection && redirect.type == redirection::kind::none && split_redirection(stage, redirect);
+	}
+
+	std::vector<std::vector<std::string>> command_lines;
+	command_lines.reserve(stages.size());
+	for (std::string_view stage : stages) {
+		std::optional<std::vector<std::string>> splitted = split_by_space(stage);
+		if (!splitted) {
+			try_log({m_command_buffer.data(), m_buffer_usage}, message::type::user_input);
+			try_log("Unmatched \"", message::type::error);
+			return;
+		}
+		command_lines.emplace_back(std::move(*splitted));
 	}
 
 	try_log({m_command_buffer.data(), m_buffer_usage}, message::type::user_input);
-	if (splitted->empty()) {
+	if (command_lines.size() == 1 && command_lines.front().empty() && redirect.type == redirection::kind::none && valid_redirection) {
 		return;
 	}
 	if (modified) {
 		try_log("> " + resolved.second, message::type::cmd_history_completion);
 	}
 
-	std::vector<command_type_cref> matching_command_list = m_t_helper->find_commands_by_prefix(splitted->front());
-	if (matching_command_list.empty()) {
-		splitted->front() += ": command not found";
-		try_log(splitted->front(), message::type::error);
+	auto push_to_history = [this, &resolved]() {
 		m_command_history.emplace_back(std::move(resolved.second));
+		trim_history();
+	};
+
+	if (!valid_redirection) {
+		try_log("Invalid redirection: expected a single file or @name after '>' or '>>', on the last command", message::type::error);
+		push_to_history();
 		return;
 	}
 
-	argument_type arg{m_argument_value, *this, *splitted};
+	if (std::any_of(command_lines.begin(), command_lines.end(), [](const std::vector<std::string>& line) { return line.empty(); })) {
+		try_log("Missing command", message::type::error);
+		push_to_history();
+		return;
+	}
 
-	matching_command_list[0].get().call(arg);
-	m_command_history.emplace_back(std::move(resolved.second)); // resolved.second has ownership over *splitted
+	// every command of the pipeline is looked up before running the first one
+	std::vector<const command_type*> commands;
+	commands.reserve(command_lines.size());
+	for (std::vector<std::string>& command_line : command_lines) {
+		// an exact match is the first of the commands prefixed by the name, looking it up first when the helper can do it directly
+		const command_type* command = nullptr;
+		if constexpr (misc::is_detected_with_return_type_v<details::find_command_method, const command_type*, TerminalHelper>) {
+			command = m_t_helper->find_command(command_line.front());
+		}
+		if (command == nullptr) {
+			std::vector<command_type_cref> matching_command_list = m_t_helper->find_commands_by_prefix(command_line.front());
+			if (!matching_command_list.empty()) {
+				command = &matching_command_list[0].get();
+			}
+		}
+		if (command == nullptr) {
+			command_line.front() += ": command not found";
+			try_log(command_line.front(), message::type::error);
+			push_to_history();
+			return;
+		}
+		commands.push_back(command);
+	}
+
+	const bool redirected = redirect.type != redirection::kind::none;
+	std::shared_ptr<file_writer> writer;
+	if (redirected && redirect.target.front() != '@') {
+		// redirections to the same file share its writer until the next frame (see show)
+		const bool append = redirect.type == redirection::kind::append;
+		auto same_file = std::find_if(m_file_writers.begin(), m_file_writers.end(), [&](const std::shared_ptr<file_writer>& w) {
+			return w->path() == redirect.target;
+		});
+		if (same_file != m_file_writers.end() && !(*same_file)->closed()) {
+			writer = *same_file;
+			if (!append) {
+				writer->truncate();
+			}
+		} else {
+			if (same_file != m_file_writers.end()) {
+				// closed, but maybe not done yet: waiting for it, so that lines are written in order
+				report_writer(**same_file);
+				m_file_writers.erase(same_file);
+			}
+			writer = m_file_writers.emplace_back(std::make_shared<file_writer>(redirect.target, append));
+		}
+	}
+
+	// each command but the last one writes its text to 'output', whose lines are given to the next command as 'input'
+	// the last command writes to 'output' only if it is redirected. For files, output is handed to the writer by batches
+	std::vector<std::string> input_buffer;
+	std::vector<std::string> output;
+	std::vector<std::string_view> input;
+	for (std::size_t i = 0 ; i < commands.size() ; ++i) {
+		const bool is_last = i + 1 == commands.size();
+		argument_type arg{m_argument_value, *this, std::move(command_lines[i]), std::move(input)};
+
+		m_pipe_output = is_last && !redirected ? nullptr : &output;
+		m_output_writer = is_last ? writer.get() : nullptr;
+		commands[i]->call(arg);
+		m_pipe_output = nullptr;
+		m_output_writer = nullptr;
+
+		if (!is_last) {
+			input_buffer.swap(output);
+			output.clear();
+			input.clear();
+			for (std::string_view text : input_buffer) {
+				std::string_view::size_type line_beg = 0u;
+				do {
+					const std::string_view::size_type line_end = std::min(text.find('\n', line_beg), text.size());
+					input.push_back(text.substr(line_beg, line_end - line_beg));
+					line_beg = line_end + 1;
+				} while (line_beg < text.size());
+			}
+		}
+	}
+
+	if (writer) {
+		writer->write(std::move(output));
+	} else if (redirected) {
+		std::vector<std::string>& buffer = m_output_buffers[redirect.target.substr(1)];
+		if (redirect.type == redirection::kind::truncate) {
+			buffer = std::move(output);
+		} else {
+			buffer.insert(buffer.end(), std::make_move_iterator(output.begin()), std::make_move_iterator(output.end()));
+		}
+	}
+	push_to_history();
+}
+
+template <typename TerminalHelper>
+bool terminal<TerminalHelper>::split_redirection(std::string_view& command, redirection& redirect) const {
+	std::string_view::size_type pos = std::string_view::npos;
+	bool quoted = false;
+	for (std::string_view::size_type i = 0 ; i < command.size() && pos == std::string_view::npos ; ++i) {
+		if (command[i] == '\\') {
+			++i; // escaped character: same rules as split_by_space
+		} else if (command[i] == '"') {
+			quoted = !quoted;
+		} else if (command[i] == '>' && !quoted && (i == 0 || trim_trailing_spaces(command.substr(0, i)).size() != i)) {
+			pos = i; // only a '>' beginning a word redirects: "echo 1>2" prints "1>2"
+		}
+	}
+	if (pos == std::string_view::npos) {
+		return true;
+	}
+
+	std::string_view target = command.substr(pos + 1);
+	redirect.type = redirection::kind::truncate;
+	if (!target.empty() && target.front() == '>') {
+		redirect.type = redirection::kind::append;
+		target.remove_prefix(1);
+	}
+	command = trim_trailing_spaces(command.substr(0, pos));
+
+	std::optional<std::vector<std::string>> splitted = split_by_space(target);
+	if (!splitted) {
+		return false;
+	}
+	while (!splitted->empty() && splitted->back().empty()) { // trailing spaces
+		splitted->pop_back();
+	}
+	if (splitted->size() != 1 || splitted->front().empty() || splitted->front() == "@") {
+		return false;
+	}
+	redirect.target = std::move(splitted->front());
+	return true;
+}
+
+template <typename TerminalHelper>
+void terminal<TerminalHelper>::capture_output(std::string&& str) {
+	m_pipe_output->emplace_back(std::move(str));
+	if (m_output_writer != nullptr && m_pipe_output->size() >= file_writer::batch_size) {
+		m_output_writer->write(std::move(*m_pipe_output));
+		m_pipe_output->clear();
+	}
+}
+
+template <typename TerminalHelper>
+void terminal<TerminalHelper>::trim_history() {
+	if (m_max_history_len == 0u || m_command_history.size() <= m_max_history_len) {
+		return;
+	}
+	const auto dropped = m_command_history.size() - m_max_history_len;
+	m_command_history.erase(m_command_history.begin(), m_command_history.begin() + static_cast<std::ptrdiff_t>(dropped));
+	m_last_flush_at_history -= dropped; // may wrap around: the [-n] indicator only uses its difference with the history size
+	m_current_history_selection = {};
 }
 
 template <typename TerminalHelper>
@@ -1498,9 +2236,51 @@ unsigned long terminal<TerminalHelper>::get_length(std::string_view str) const {
 	return details::get_length(m_t_helper, str);
 }
 
+template <typename TerminalHelper>
+std::vector<std::string_view> terminal<TerminalHelper>::split_by_pipe(std::string_view in) const {
+	std::vector<std::string_view> out;
+	std::string_view::size_type beg = 0u;
+	bool quoted = false;
+	for (std::string_view::size_type i = 0 ; i < in.size() ; ++i) {
+		if (in[i] == '\\') {
+			++i; // escaped character: same rules as split_by_space
+		} else if (in[i] == '"') {
+			quoted = !quoted;
+		} else if (in[i] == '|' && !quoted) {
+			out.push_back(trim_trailing_spaces(in.substr(beg, i - beg)));
+			beg = i + 1;
+		}
+	}
+	out.push_back(trim_trailing_spaces(in.substr(beg)));
+	return out;
+}
+
+template <typename TerminalHelper>
+std::string_view terminal<TerminalHelper>::trim_trailing_spaces(std::string_view in) const {
+	std::string_view::size_type end = 0u; // end of the last character that is not a space
+	std::string_view::size_type i = 0u;
+	while (i < in.size()) {
+		if (in[i] == '\\') {
+			i = std::min(i + 2, in.size()); // escaped character: same rules as split_by_space
+			end = i;
+			continue;
+		}
+		const int space_count = is_space(in.substr(i));
+		if (space_count > 0) {
+			i += static_cast<std::string_view::size_type>(space_count);
+		} else {
+			end = ++i;
+		}
+	}
+	return in.substr(0, end);
+}
+
 template <typename TerminalHelper>
 std::optional<std::vector<std::string>> terminal<TerminalHelper>::split_by_space(std::string_view in, bool ignore_non_match) const {
 	std::vector<std::string> out;
+	if (in.empty()) {
+		return out;
+	}
 
 	const char* it = &in[0];
 	const char* const in_end = &in[in.size() - 1] + 1;
@@ -1590,13 +2370,235 @@ std::optional<std::vector<std::string>> terminal<TerminalHelper>::split_by_space
 
 template <typename TerminalHelper>
 void terminal<TerminalHelper>::push_message(message&& msg) {
-	try_lock();
-	if (m_logs.size() == m_max_log_len) {
-		m_logs[m_current_log_oldest_idx] = std::move(msg);
-		m_current_log_oldest_idx = (m_current_log_oldest_idx + 1) % m_logs.size();
-	} else {
-		m_logs.emplace_back(std::move(msg));
+	message_store::view_id origin = msg.is_term_message ? m_view_id : message_store::no_view;
+	m_store->push(std::move(msg), origin);
+}
+
+template <typename TerminalHelper>
+void terminal<TerminalHelper>::push_message(message&& msg, std::size_t identity) {
+	message_store::view_id origin = msg.is_term_message ? m_view_id : message_store::no_view;
+	m_store->push(std::move(msg), origin, identity);
+}
+
+template <typename TerminalHelper>
+void terminal<TerminalHelper>::compile_filter() {
+#ifdef IMTERM_ENABLE_REGEX
+	std::string_view filter{m_log_text_filter_buffer.data(), m_log_text_filter_buffer_usage};
+	if (!m_regex_search || filter.empty() || (m_compiled_filter && *m_compiled_filter == filter)) {
+		return;
+	}
+	m_compiled_filter.emplace(filter);
+	try {
+		m_filter_regex.emplace(filter.begin(), filter.end());
+	} catch (const std::regex_error&) {
+		m_filter_regex.reset();
+	}
+#endif
+}
+
+template <typename TerminalHelper>
+bool terminal<TerminalHelper>::update_match_index() {
+	std::string_view filter{m_log_text_filter_buffer.data(), m_log_text_filter_buffer_usage};
+	const int level = m_level + m_lowest_log_level_val;
+	compile_filter(); // no-op if the caller did it, as it should
+
+	m_store->report_drops();
+
+	// as stamps never decrease with sequence numbers, the time range is a range of sequence numbers
+	std::chrono::system_clock::time_point time_from = m_time_from;
+	if (m_time_window != std::chrono::system_clock::duration::zero()) {
+		time_from = std::max(time_from, std::chrono::system_clock::now() - m_time_window);
+	}
+	const message_store::seq_type time_beg = m_store->seq_at(time_from);
+	const message_store::seq_type time_end = m_store->seq_at(m_time_to);
+
+	// a range that moved forward (sliding window, new messages in the range) is handled incrementally, like evicted and new messages
+	const bool criteria_changed = filter != m_indexed_filter || level != m_indexed_level || m_channel_mask != m_indexed_channel_mask
+			|| time_beg < m_indexed_time_beg || time_end < m_indexed_time_end;
+	if (!criteria_changed && m_store->generation() == m_indexed_generation && time_beg == m_indexed_time_beg && m_indexed_until >= time_end) {
+		return true;
+	}
+	m_indexed_generation = m_store->generation();
+	m_indexed_time_beg = time_beg;
+	m_indexed_time_end = time_end;
+
+	if (criteria_changed) {
+		m_indexed_filter.assign(filter.begin(), filter.end());
+		m_indexed_level = level;
+		m_indexed_channel_mask = m_channel_mask;
+		m_matching.clear();
+		m_layout.clear();
+		for (message_store::seq_list& masked_out : m_masked_out) {
+			masked_out.clear();
+		}
+		m_indexed_until = m_cleared_until;
+	}
+
+	while (!m_matching.empty() && m_matching.front() < std::max(m_store->first_seq(), time_beg)) {
+		m_matching.pop_front();
+		if (!m_layout.empty()) {
+			m_layout.pop_front();
+		}
+	}
+
+	const message_store::seq_type from = std::max({m_indexed_until, m_store->first_seq(), time_beg});
+	const message_store::seq_type target = std::max(time_end, from);
+	const message_store::seq_type end = std::min(target, from + index_chunk_size);
+	m_indexed_until = end;
+	m_store->mark_consumed(m_store->end_seq());
+
+	// level counts: messages of [count_beg, end), minus the ones whose channel is not displayed
+	// the latter are the only ones visited, and only when they are indexed for the first time
+	const message_store::seq_type count_beg = std::max({m_cleared_until, m_store->first_seq(), time_beg});
+	for (std::size_t i = 0 ; i < m_level_counts.size() ; ++i) {
+		const message_store::seq_list& list = m_store->messages_of(static_cast<message::severity::severity_t>(i));
+		message_store::seq_list& masked_out = m_masked_out[i];
+		if (~m_channel_mask != 0u) {
+			for (auto it = std::lower_bound(list.begin(), list.end(), from) ; it != list.end() && *it < end ; ++it) {
+				if (!((m_channel_mask >> m_store->at(*it).channel) & 1u)) {
+					masked_out.push_back(*it);
+				}
+			}
+		}
+		while (!masked_out.empty() && masked_out.front() < count_beg) {
+			masked_out.pop_front();
+		}
+
+		auto beg = std::lower_bound(list.begin(), list.end(), count_beg);
+		m_level_counts[i] = static_cast<message_store::size_type>(std::lower_bound(beg, list.end(), end) - beg) - masked_out.size();
+	}
+
+	if (from == end) {
+		return true;
+	}
+
+#ifdef IMTERM_ENABLE_REGEX
+	const bool regex = m_regex_search && !filter.empty();
+	if (regex && !m_filter_regex) {
+		m_indexed_until = target; // malformed regex is treated as no match
+		return true;
+	}
+#endif
+
+	// the filter is matched against the displayed text, which for deferred messages requires formatting them (store locked)
+	// the raw payload is not enough: the filter may match the time, level or logger name added by the formatter
+	auto text_matches = [&](message_store::seq_type seq) {
+		if (filter.empty()) {
+			return true;
+		}
+		const message& msg = m_store->formatted(seq);
+		if (msg.value.empty()) {
+			return true;
+		}
+#ifdef IMTERM_ENABLE_REGEX
+		if (regex) {
+			return std::regex_search(msg.value, *m_filter_regex);
+		}
+#endif
+		return std::search(msg.value.begin(), msg.value.end(), filter.begin(), filter.end()) != msg.value.end();
+	};
+
+	// merging the indexes of the displayed severities and of terminal messages, so that only candidate messages are visited
+	using seq_range = std::pair<message_store::seq_list::const_iterator, message_store::seq_list::const_iterator>;
+	std::array<seq_range, message::severity::critical + 2> ranges;
+	auto ranges_end = ranges.begin();
+	auto add_range = [&](const message_store::seq_list& list) {
+		auto beg = std::lower_bound(list.begin(), list.end(), from);
+		auto last = std::lower_bound(beg, list.end(), end);
+		if (beg != last) {
+			*ranges_end++ = {beg, last};
+		}
+	};
+
+	add_range(m_store->term_messages());
+	for (int i = std::max(level, 0) ; i <= message::severity::critical ; ++i) {
+		add_range(m_store->messages_of(static_cast<message::severity::severity_t>(i)));
+	}
+
+	while (ranges_end != ranges.begin()) {
+		auto next = std::min_element(ranges.begin(), ranges_end, [](const seq_range& lhs, const seq_range& rhs) {
+			return *lhs.first < *rhs.first;
+		});
+		const message_store::seq_type seq = *next->first;
+		if (++next->first == next->second) {
+			*next = *--ranges_end;
+		}
+
+		const message& msg = m_store->at(seq);
+		if (msg.is_term_message) {
+			if (m_store->origin(seq) != m_view_id) {
+				continue;
+			}
+		} else if (!((m_channel_mask >> msg.channel) & 1u)) {
+			continue;
+		}
+		if (text_matches(seq)) {
+			m_matching.push_back(seq);
+		}
+	}
+	return end == target;
+}
+
+template <typename TerminalHelper>
+void terminal<TerminalHelper>::compute_layout(std::string_view text, std::string_view prefix, std::string_view suffix, message_layout& layout) {
+	layout.line_breaks.clear();
+
+	ImFont* font = ImGui::GetFont();
+	const float font_size = ImGui::GetFontSize();
+	const float scale = font_size / font->FontSize;
+	auto width_of = [&](const char* beg, const char* end) {
+		return font->CalcTextSizeA(font_size, FLT_MAX, 0.f, beg, end).x;
+	};
+
+	const char* const text_beg = text.data();
+	const char* const text_end = text_beg + text.size();
+	const char* line = text_beg;
+	float indent = width_of(prefix.data(), prefix.data() + prefix.size());
+	while (true) {
+		const char* new_line = std::find(line, text_end, '\n');
+		const char* line_end = new_line;
+		if (m_layout_wrap_width > 0.f && line != new_line) {
+			line_end = font->CalcWordWrapPositionA(scale, line, new_line, std::max(m_layout_wrap_width - indent, 1.f));
+			if (line_end == line) { // not even a single character fits: it is put alone on its line
+				do {
+					++line_end;
+				} while (line_end != new_line && (static_cast<unsigned char>(*line_end) & 0xC0u) == 0x80u);
+			}
+		} else if (m_layout_wrap_width <= 0.f) {
+			m_layout_width = std::max(m_layout_width, indent + width_of(line, line_end));
+		}
+
+		const char* next = line_end;
+		if (line_end == new_line) {
+			if (new_line == text_end) {
+				break;
+			}
+			++next;
+		} else {
+			// same as ImGui: blanks and a single new line are skipped after a wrapped line
+			while (next != new_line && (*next == ' ' || *next == '\t')) {
+				++next;
+			}
+			if (next == text_end) {
+				break;
+			}
+			if (next == new_line) {
+				++next;
+			}
+		}
+		layout.line_breaks.push_back({static_cast<std::string::size_type>(line_end - text_beg), static_cast<std::string::size_type>(next - text_beg)});
+		line = next;
+		indent = 0.f;
+	}
+
+	if (!suffix.empty()) {
+		const float last_line_width = indent + width_of(line, text_end);
+		const float suffix_width = width_of(suffix.data(), suffix.data() + suffix.size());
+		if (m_layout_wrap_width <= 0.f) {
+			m_layout_width = std::max(m_layout_width, last_line_width + suffix_width);
+		} else if (last_line_width > 0.f && last_line_width + suffix_width > m_layout_wrap_width) {
+			layout.line_breaks.push_back({text.size(), text.size()});
+		}
 	}
-	try_unlock();
 }
 } // namespace term
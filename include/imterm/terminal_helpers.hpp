@@ -18,10 +18,13 @@
 ///                                                                                                                                     ///
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-#include <set>
 #include <array>
+#include <map>
 
 #include "terminal.hpp"
+#include "command_registry.hpp"
+#include "command_table.hpp"
+#include "arguments.hpp"
 #if __has_include("spdlog/spdlog.h")
 #include "spdlog/common.h"
 #include "spdlog/formatter.h"
@@ -36,6 +39,26 @@ namespace ImTerm::details {
 	constexpr spdlog::level::level_enum to_spdlog_severity(message::severity::severity_t);
 	constexpr spdlog::level::level_enum to_spdlog_severity(message::type);
 	inline ImTerm::message to_imterm_msg(const spdlog::details::log_msg&);
+
+	// formats messages logged in deferred mode, see basic_spdlog_terminal_helper::set_deferred_formatting
+	class spdlog_message_formatter : public message_formatter {
+	public:
+		explicit spdlog_message_formatter(std::unique_ptr<spdlog::formatter> formatter) : m_formatter{std::move(formatter)} {}
+
+		void format(message& msg, std::string_view channel_name) override {
+			spdlog::details::log_msg log_msg{msg.first_time, {}, {channel_name.data(), channel_name.size()}, to_spdlog_severity(msg.severity), msg.value};
+			log_msg.thread_id = msg.thread_id;
+
+			spdlog::memory_buf_t buff{};
+			m_formatter->format(log_msg, buff);
+			msg.color_beg = log_msg.color_range_start;
+			msg.color_end = log_msg.color_range_end;
+			msg.value = fmt::to_string(buff);
+		}
+
+	private:
+		std::unique_ptr<spdlog::formatter> m_formatter;
+	};
 }
 #endif
 
@@ -55,11 +78,8 @@ namespace ImTerm {
 
 		// mandatory : return every command starting by prefix
 		std::vector<command_type_cref> find_commands_by_prefix(std::string_view prefix) {
-
-			auto compare_by_name = [](const command_type& cmd) { return cmd.name; };
-			auto map_to_cref = [](const command_type& cmd) { return std::cref(cmd); };
-
-			return misc::prefix_search(prefix, cmd_list.begin(), cmd_list.end(), std::move(compare_by_name), std::move(map_to_cref));
+			auto [beg, end] = commands::find_by_prefix(prefix);
+			return {beg, end};
 		}
 
 		// mandatory : return every command starting by the text formed by [beg, end)
@@ -69,7 +89,13 @@ namespace ImTerm {
 
 		// mandatory: returns the full command list
 		std::vector<command_type_cref> list_commands() {
-			return find_commands_by_prefix(std::string_view{});
+			return {commands::begin(), commands::end()};
+		}
+
+		// optional : returns the command of the given name, nullptr if there is none
+		// used by the terminal to look up the command to call without going through every command starting by that name
+		const command_type* find_command(std::string_view name) {
+			return commands::find(name);
 		}
 
 		// mandatory: formats the given string.
@@ -130,6 +156,9 @@ namespace ImTerm {
 				command_type{"clear ", "clears the screen", clear, no_completion},
 				command_type{"echo ", "prints text to the screen", echo, no_completion},
 		};
+
+		// sorted and checked at compile time
+		using commands = ImTerm::static_command_table<cmd_list>;
 	};
 
 	// Basic terminal helper
@@ -137,6 +166,7 @@ namespace ImTerm {
 	// Template parameter TerminalHelper is in most cases the derived class (and should be if you don't know what to put)
 	// Template parameter Value is the type passed to commands together with the other arguments
 	// You may add commands with the 'add_command_' method.
+	// Commands may also be added and removed from any thread with the 'add_command' and 'remove_command' methods (see command_registry)
 	// Refer to terminal_helper_example (see above) for a commented example
 	template <typename TerminalHelper, typename Value>
 	class basic_terminal_helper {
@@ -152,11 +182,7 @@ namespace ImTerm {
 		basic_terminal_helper(basic_terminal_helper&&) noexcept = default;
 
 		std::vector<command_type_cref> find_commands_by_prefix(std::string_view prefix) {
-			auto compare_name = [](const command_type& cmd) { return cmd.name; };
-			auto map_to_cref = [](const command_type& cmd) { return std::cref(cmd); };
-
-			return misc::prefix_search(prefix, cmd_list_.begin(), cmd_list_.end(), std::move(compare_name),
-			                           std::move(map_to_cref));
+			return commands_.find_by_prefix(prefix);
 		}
 
 		std::vector<command_type_cref> find_commands_by_prefix(const char * beg, const char * end) {
@@ -164,12 +190,29 @@ namespace ImTerm {
 		}
 
 		std::vector<command_type_cref> list_commands() {
-			std::vector<command_type_cref> ans;
-			ans.reserve(cmd_list_.size());
-			for (const command_type& cmd : cmd_list_) {
-				ans.emplace_back(cmd);
-			}
-			return ans;
+			return commands_.list();
+		}
+
+		// optional method, returns the command of the given name, nullptr if there is none
+		const command_type* find_command(std::string_view name) {
+			return commands_.find(name);
+		}
+
+		// optional method, called by the terminal when it holds no reference to commands
+		// makes the commands added or removed since the last call visible, returns true if there were such commands
+		bool sync_commands() {
+			return commands_.synchronize();
+		}
+
+		// adds a command, replacing the command of the same name if any. May be called from any thread
+		// the command is available to the terminal from its next frame
+		void add_command(const command_type& cmd) {
+			commands_.add(cmd);
+		}
+
+		// removes the command of the given name, returns false if there is none. May be called from any thread
+		bool remove_command(std::string_view name) {
+			return commands_.remove(name);
 		}
 
 		std::optional<ImTerm::message> format(std::string str, ImTerm::message::type) {
@@ -181,10 +224,10 @@ namespace ImTerm {
 
 	protected:
 		void add_command_(const command_type& cmd) {
-			cmd_list_.emplace(cmd);
+			commands_.add(cmd);
 		}
 
-		std::set<command_type> cmd_list_{};
+		command_registry<command_type> commands_{};
 	};
 
 #ifdef IMTERM_SPDLOG_INCLUDED
@@ -193,7 +236,7 @@ namespace ImTerm {
 	// You may inherit to save some hassle
 	// Template parameter TerminalHelper is in most cases the derived class (and should be if you don't know what to put)
 	// Template parameter Value is the type passed to commands together with the other arguments
-	// Template parameter Mutex is passed to spdlog::sinks::base_sink
+	// Template parameter Mutex is passed to spdlog::sinks::base_sink: misc::no_mutex is only safe if a single thread logs to the sink
 	// You may add commands with the 'add_command_' method.
 	// Refer to terminal_helper_example (see above) for a commented example
 	// should not be used after move
@@ -217,6 +260,7 @@ namespace ImTerm {
 			, terminal_{std::exchange(other.terminal_, nullptr)}
 			, terminal_formatter_{std::move(other.terminal_formatter_)}
 			, logger_name_{std::move(other.logger_name_)}
+			, deferred_formatting_{other.deferred_formatting_}
 		{
 			SinkBase::set_level(other.level());
 			SinkBase::set_formatter(std::move(other.formatter_));
@@ -251,6 +295,16 @@ namespace ImTerm {
 			set_terminal_formatter_(std::move(terminal_formatter), type);
 		}
 
+		// if enabled, logged messages are stored unformatted (timestamp, level, logger name and payload)
+		// the pattern is applied the first time each message is displayed, filtered or exported. While a text filter is set,
+		// the terminal formats every message of the displayed levels and channels as it indexes it, to match its displayed text
+		// messages are formatted with the pattern that was set when they were logged
+		void set_deferred_formatting(bool enabled) {
+			std::lock_guard<Mutex> lock(SinkBase::mutex_);
+			deferred_formatting_ = enabled;
+			deferred_formatter_.reset();
+		}
+
 	protected:
 
 		void set_terminal_pattern_(const std::string& pattern, ImTerm::message::type type) {
@@ -266,17 +320,77 @@ namespace ImTerm {
 				return;
 			}
 			assert(terminal_ != nullptr);
+			const message::channel_id channel = channel_of_(msg.logger_name);
+			if (!terminal_->accepts_channel(channel)) {
+				return;
+			}
+
+			const message::severity::severity_t severity = details::to_imterm_severity(msg.level);
+			std::size_t identity = 0u;
+			if (terminal_->repeat_window() > 0) {
+				identity = message_store::identity_of({msg.payload.data(), msg.payload.size()});
+				if (terminal_->add_repeat(identity, severity, channel, msg.time)) {
+					return;
+				}
+			}
+
+			if (deferred_formatting_) {
+				if (!deferred_formatter_) {
+					deferred_formatter_ = std::make_shared<details::spdlog_message_formatter>(SinkBase::formatter_->clone());
+				}
+				message term_msg{severity, {msg.payload.data(), msg.payload.size()}, 0u, 0u, false, channel};
+				term_msg.formatter = deferred_formatter_;
+				term_msg.time = msg.time;
+				term_msg.thread_id = msg.thread_id;
+				terminal_->add_message(std::move(term_msg), identity);
+				return;
+			}
+
             spdlog::memory_buf_t buff{};
 			SinkBase::formatter_->format(msg, buff);
-			terminal_->add_message({details::to_imterm_severity(msg.level), fmt::to_string(buff)
-								 , msg.color_range_start, msg.color_range_end, false});
+			message term_msg{severity, fmt::to_string(buff), msg.color_range_start, msg.color_range_end, false, channel};
+			term_msg.time = msg.time;
+			term_msg.thread_id = msg.thread_id;
+			terminal_->add_message(std::move(term_msg), identity);
+		}
+
+		// channel of the messages logged by the given logger, only looked up in the message store (and its lock taken) once per logger
+		message::channel_id channel_of_(spdlog::string_view_t logger_name) {
+			message_store* store = &terminal_->message_store_ref();
+			if (store != channels_store_) { // channel ids are specific to each store
+				channel_ids_.clear();
+				channels_store_ = store;
+			}
+
+			std::string_view name{logger_name.data(), logger_name.size()};
+			auto it = channel_ids_.find(name);
+			if (it == channel_ids_.end()) {
+				it = channel_ids_.emplace(name, terminal_->channel(name)).first;
+			}
+			return it->second;
 		}
 
 		void flush_() override {}
 
+		void set_pattern_(const std::string& pattern) override {
+			SinkBase::set_pattern_(pattern);
+			deferred_formatter_.reset();
+		}
+
+		void set_formatter_(std::unique_ptr<spdlog::formatter> sink_formatter) override {
+			SinkBase::set_formatter_(std::move(sink_formatter));
+			deferred_formatter_.reset();
+		}
+
 		term_t* terminal_{};
 		std::array<std::unique_ptr<spdlog::formatter>, 3> terminal_formatter_{}; // user_input, error, cmd_history_completion (c.f. ImTerm::message::type)
 		std::string logger_name_;
+
+		std::map<std::string, message::channel_id, std::less<>> channel_ids_{}; // cache of channel_of_, by logger name
+		const message_store* channels_store_{}; // store channel_ids_ refers to
+
+		bool deferred_formatting_{false};
+		std::shared_ptr<details::spdlog_message_formatter> deferred_formatter_{}; // shared by messages logged with the current pattern
 	};
 
 
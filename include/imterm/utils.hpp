@@ -18,8 +18,12 @@
 ///                                                                                                                                     ///
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+#include <cstdint>
+#include <chrono>
+#include <memory>
 #include <string>
 #include <string_view>
+#include <vector>
 #include <array>
 #include <optional>
 #include <array>
@@ -37,6 +41,10 @@ namespace ImTerm {
 		Terminal& term; // reference to the ImTerm::terminal that called the command
 
 		std::vector<std::string> command_line; // list of arguments the user specified in the command line. command_line[0] is the command name
+
+		// lines written by the previous command of a pipeline ("previous_command | command"), empty if the command is not piped.
+		// They are only valid during the call
+		std::vector<std::string_view> input{};
 	};
 
 	// structure used to represent a command
@@ -65,6 +73,8 @@ namespace ImTerm {
 		}
 	};
 
+	struct message_formatter;
+
 	struct message {
 		enum class type {
 			user_input,             // terminal wants to log user input
@@ -82,6 +92,11 @@ namespace ImTerm {
 			};
 		};
 
+		using channel_id = std::uint8_t; // see message_store::channel
+		using channel_mask = std::uint64_t; // one bit per channel id
+		static constexpr channel_id default_channel = 0u;
+		static constexpr unsigned int max_channels = 64u;
+
 		severity::severity_t severity; // severity of the message
 		std::string value; // text to be displayed
 
@@ -93,6 +108,37 @@ namespace ImTerm {
 		bool is_term_message; // if set to true, current msg is considered to be originated from the terminal,
 		// never filtered out by severity filter, and applying for different rules regarding colors.
 		// severity is also ignored for such messages
+
+		channel_id channel{default_channel}; // source of the message (spdlog logger, subsystem, ...)
+
+		// deferred formatting: if set, 'value' holds the raw payload, and the displayed text will be produced by the formatter
+		// the first time the message is displayed, filtered or exported (see message_store::formatted)
+		// a terminal with a text filter formats the messages it indexes, as the filter may match the formatted part of the text
+		std::shared_ptr<message_formatter> formatter{};
+		std::chrono::system_clock::time_point time{}; // time of logging (of the last repetition if repeat_count > 1), set by the message store if empty
+		std::size_t thread_id{0u}; // id of the logging thread, used by formatters
+		std::chrono::steady_clock::time_point ingest_time{}; // set by terminal::add_message when latency tracing is enabled (see terminal::set_latency_tracing)
+
+		unsigned int repeat_count{1u}; // number of times this message was logged in a row (see message_store::set_repeat_window)
+		std::chrono::system_clock::time_point first_time{}; // time of the first repetition, set by the message store
+
+		// text color of value[beg, end), overriding the severity color (but not the highlighting of filter matches)
+		struct color_span {
+			std::uint32_t beg;
+			std::uint32_t end;
+			std::uint32_t rgba; // 0xRRGGBBAA
+		};
+		std::vector<color_span> color_spans{}; // sorted, non overlapping. Filled from ANSI escape sequences (see ansi::parse_sgr)
+	};
+
+	// formats messages whose formatting was deferred
+	struct message_formatter {
+		virtual ~message_formatter() = default;
+
+		// replaces msg.value by its formatted counterpart, setting the color range appropriately
+		// channel_name is the name of msg.channel
+		// called at most once per message, by the thread displaying the message, with the message store locked
+		virtual void format(message& msg, std::string_view channel_name) = 0;
 	};
 
 	enum class config_panels {